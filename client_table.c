@@ -0,0 +1,110 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utils/util.h>
+
+#include "client_table.h"
+
+client_entry_t *client_table;
+seL4_Word client_table_num;
+seL4_Word client_table_live;
+static seL4_Word client_table_room;
+
+/* requests of the clients that have detached */
+static seL4_Word detached_num, detached_min, detached_max;
+
+static int
+client_table_grow(seL4_Word room)
+{
+    client_entry_t *table;
+
+    table = realloc(client_table, room * sizeof(client_entry_t));
+    if (table == NULL) {
+        return -1;
+    }
+    memset(table + client_table_room, 0, (room - client_table_room) * sizeof(client_entry_t));
+
+    client_table = table;
+    client_table_room = room;
+
+    return 0;
+}
+
+int
+client_table_init(int num)
+{
+    if ((seL4_Word) num <= client_table_room) {
+        return 0;
+    }
+
+    return client_table_grow(num);
+}
+
+seL4_Word
+client_badge_alloc(void)
+{
+    UNUSED int error;
+
+    if (client_table_num == client_table_room) {
+        error = client_table_grow(client_table_room ? client_table_room * 2 : 8);
+        assert(error == 0);
+    }
+
+    return ++ client_table_num;
+}
+
+void
+client_table_attach(seL4_Word badge)
+{
+    client_entry_t *client = client_table_lookup(badge);
+
+    assert(client != NULL && !client->attached);
+
+    client->attached = 1;
+    client_table_live ++;
+}
+
+void
+client_table_detach(seL4_Word badge)
+{
+    client_entry_t *client = client_table_lookup(badge);
+
+    assert(client != NULL && client->attached && client_table_live > 0);
+
+    if (detached_num == 0 || client->requests < detached_min) {
+        detached_min = client->requests;
+    }
+    if (client->requests > detached_max) {
+        detached_max = client->requests;
+    }
+    detached_num ++;
+
+    memset(client, 0, sizeof(*client));
+    client_table_live --;
+}
+
+void
+client_table_info(void)
+{
+    seL4_Word i, n = detached_num, min = detached_min, max = detached_max;
+
+    for (i = 0;i < client_table_num;i ++) {
+        /* detached entries are cleared, their counts are kept above */
+        if (client_table[i].requests == 0) {
+            continue;
+        }
+        if (n == 0 || client_table[i].requests < min) {
+            min = client_table[i].requests;
+        }
+        if (client_table[i].requests > max) {
+            max = client_table[i].requests;
+        }
+        n ++;
+    }
+
+    printf("COLLECTION - clients badges %lu room %lu live %lu requests min %lu max %lu\n",
+           (unsigned long) client_table_num, (unsigned long) client_table_room,
+           (unsigned long) client_table_live, (unsigned long) min, (unsigned long) max);
+}
@@ -0,0 +1,70 @@
+/*
+    Per-client state indexed by endpoint badge.
+
+    Every client's copy of the server endpoint is minted with a badge of
+    its own, handed out by client_badge_alloc() in spawn order: 1, 2, ...
+    The kernel delivers the badge with each message, so the server finds
+    the sender's entry with one subtraction instead of trusting an id the
+    client wrote into MR0, and a client cannot pass itself off as another.
+    Badge 0 (an unbadged cap) and badges never handed out have no entry.
+
+    The table is one array of small entries, grown as badges are handed
+    out. A badge minted while the server runs may move the entries, so
+    do not keep an entry pointer across a call that can switch threads.
+    There is one run per boot: the clients of a run have the ids
+    0 .. n - 1, id = badge - 1.
+
+    A client is attached from its INIT to its TMNT. The server drops a
+    second INIT and any other message from a client that is not attached.
+    Detaching clears its entry, so the badge can INIT again and a
+    long-running server keeps no state for clients that have left.
+*/
+#ifndef CLIENT_TABLE_H
+#define CLIENT_TABLE_H
+
+#include <sel4/sel4.h>
+
+typedef struct client_entry_t {
+    /* slot the client's INIT reply cap was saved in */
+    seL4_Word reply_ep;
+    seL4_Word requests;
+    /* between INIT and TMNT */
+    int attached;
+} client_entry_t;
+
+extern client_entry_t *client_table;
+/* badges handed out so far, the entries in use */
+extern seL4_Word client_table_num;
+/* clients between INIT and TMNT */
+extern seL4_Word client_table_live;
+
+#define CLIENT_BADGE_ID(badge) ((int) (badge) - 1)
+
+/* Make room for num clients up front, 0 on success. */
+int client_table_init(int num);
+
+/* Badge for the next client's endpoint cap, grows the table if needed. */
+seL4_Word client_badge_alloc(void);
+
+/* entry of the client a message with badge came from, NULL if none */
+static inline client_entry_t *
+client_table_lookup(seL4_Word badge)
+{
+    /* badge 0 wraps around and fails the test too */
+    if (badge - 1 >= client_table_num) {
+        return NULL;
+    }
+
+    return &client_table[badge - 1];
+}
+
+/* The client with badge sent INIT. */
+void client_table_attach(seL4_Word badge);
+
+/* The client with badge sent TMNT: keep its counts, clear its entry. */
+void client_table_detach(seL4_Word badge);
+
+/* COLLECTION - clients line: table size and requests per client */
+void client_table_info(void);
+
+#endif
@@ -0,0 +1,330 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sel4utils/thread.h>
+#include <utils/util.h>
+#include <vka/capops.h>
+#include <vspace/page.h>
+
+#include "client_template.h"
+#include "lib_test.h"
+
+/* x86 page fault error code: the access was a write */
+#define TEMPLATE_FSR_WRITE 0x2
+
+/* The caller's sel4utils_process_t may not outlive the configure call
+ * (run_test_new() keeps it on its stack), so the pager only uses caps
+ * copied out of it here. */
+typedef struct template_client_t {
+    seL4_CPtr pd;
+    /* cap of the frame mapped at each page of the image, template_page() */
+    seL4_CPtr *pages;
+    /* this client's copy, configure_process_custom() fills in the reservations */
+    sel4utils_elf_region_t *regions;
+} template_client_t;
+
+static vka_t *template_vka;
+static vspace_t *template_vspace;
+
+static sel4utils_process_t template;
+/* per region, the template's pages mapped read-only in the driver if the
+ * region is writable, NULL otherwise */
+static void **template_copy;
+/* pages from the lowest region start to the highest region end */
+static seL4_Word template_base;
+static int template_span;
+
+static template_client_t template_clients[CLIENT_MAX];
+static volatile int template_client_num;
+static int template_shared;
+
+static vka_object_t template_fault_ep;
+static sel4utils_thread_t template_pager;
+
+/* copy-on-write reserve: mapped in the driver, and a cap for the client */
+static char *cow_pages;
+static seL4_CPtr cow_caps[CLIENT_TEMPLATE_COW_PAGES];
+static int cow_used;
+
+static seL4_Word
+region_start(int r)
+{
+    return (seL4_Word) template.elf_regions[r].elf_vstart & ~(PAGE_SIZE_4K - 1);
+}
+
+static int
+region_pages(int r)
+{
+    seL4_Word end = (seL4_Word) template.elf_regions[r].elf_vstart + template.elf_regions[r].size;
+
+    return (end - region_start(r) + PAGE_SIZE_4K - 1) / PAGE_SIZE_4K;
+}
+
+/* a page that an earlier region already covers */
+static int
+region_overlap(int r, seL4_Word vaddr)
+{
+    int i;
+
+    for (i = 0;i < r;i ++) {
+        if (vaddr >= region_start(i) && vaddr < region_start(i) + region_pages(i) * PAGE_SIZE_4K) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int
+template_page(seL4_Word vaddr)
+{
+    return (vaddr - template_base) / PAGE_SIZE_4K;
+}
+
+static int
+region_writable(int r)
+{
+    return seL4_CapRights_get_capAllowWrite(template.elf_regions[r].rights);
+}
+
+/* copy the cap of the frame at vaddr in vspace into a new slot */
+static seL4_CPtr
+template_dup(vspace_t *vspace, seL4_Word vaddr, seL4_CapRights_t rights)
+{
+    cspacepath_t src, dest;
+    seL4_CPtr cap;
+    int error;
+
+    vka_cspace_make_path(template_vka, vspace_get_cap(vspace, (void *) vaddr), &src);
+    error = vka_cspace_alloc(template_vka, &cap);
+    assert(error == 0);
+    vka_cspace_make_path(template_vka, cap, &dest);
+    error = vka_cnode_copy(&dest, &src, rights);
+    assert(error == 0);
+
+    return cap;
+}
+
+/* write to a shared page of a writable region: give the client its own copy */
+static int
+template_copy_page(template_client_t *client, seL4_Word addr)
+{
+    seL4_Word vaddr = addr & ~(PAGE_SIZE_4K - 1);
+    seL4_CPtr shared;
+    int r, page, error;
+
+    for (r = 0;r < template.num_elf_regions;r ++) {
+        if (template_copy[r] != NULL && vaddr >= region_start(r) &&
+            vaddr < region_start(r) + region_pages(r) * PAGE_SIZE_4K) {
+            break;
+        }
+    }
+    if (r == template.num_elf_regions) {
+        return -1;
+    }
+
+    if (cow_used == CLIENT_TEMPLATE_COW_PAGES) {
+        printf("template: out of copy-on-write pages, raise CLIENT_TEMPLATE_COW_PAGES\n");
+        return -1;
+    }
+    page = cow_used ++;
+
+    memcpy(cow_pages + page * PAGE_SIZE_4K,
+           (char *) template_copy[r] + (vaddr - region_start(r)), PAGE_SIZE_4K);
+
+    /* The client's vspace still books the shared cap at vaddr, the
+     * mapping is swapped underneath it. Clients are never torn down. */
+    shared = client->pages[template_page(vaddr)];
+    error = seL4_ARCH_Page_Unmap(shared);
+    assert(error == 0);
+    client->pages[template_page(vaddr)] = cow_caps[page];
+    error = seL4_ARCH_Page_Map(cow_caps[page], client->pd, vaddr,
+                               seL4_AllRights, seL4_ARCH_Default_VMAttributes);
+    assert(error == 0);
+
+    return 0;
+}
+
+static int
+template_fault(seL4_MessageInfo_t info, seL4_Word badge)
+{
+    if (badge == 0 || badge > template_client_num || !seL4_isVMFault_tag(info) ||
+        !(seL4_GetMR(seL4_VMFault_FSR) & TEMPLATE_FSR_WRITE) ||
+        template_copy_page(&template_clients[badge - 1], seL4_GetMR(seL4_VMFault_Addr)) != 0) {
+        sel4utils_print_fault_message(info, "template client");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void
+template_pager_main(void *arg0 UNUSED, void *arg1 UNUSED, void *ipc_buf UNUSED)
+{
+    seL4_MessageInfo_t info;
+    seL4_Word badge;
+
+    info = seL4_Recv(template_fault_ep.cptr, &badge);
+    while (1) {
+        if (template_fault(info, badge) == 0) {
+            /* restarts the faulting write */
+            info = seL4_ReplyRecv(template_fault_ep.cptr, seL4_MessageInfo_new(0, 0, 0, 0), &badge);
+        } else {
+            info = seL4_Recv(template_fault_ep.cptr, &badge);
+        }
+    }
+}
+
+int
+client_template_init(vka_t *vka, vspace_t *vspace, seL4_CPtr cspace, const char *image,
+                     uint8_t pager_priority)
+{
+    seL4_CPtr *caps;
+    int r, i, n, error;
+
+    template_vka = vka;
+    template_vspace = vspace;
+
+    /* the only ELF load, the template never runs */
+    error = sel4utils_configure_process(&template, vka, vspace, 0, image);
+    if (error) {
+        printf("template: cannot load %s\n", image);
+        return error;
+    }
+    assert(template.elf_regions != NULL);
+
+    template_copy = calloc(template.num_elf_regions, sizeof(void *));
+    assert(template_copy != NULL);
+
+    template_base = region_start(0);
+    for (r = 1;r < template.num_elf_regions;r ++) {
+        template_base = MIN(template_base, region_start(r));
+    }
+    for (r = 0;r < template.num_elf_regions;r ++) {
+        template_span = MAX(template_span, template_page(region_start(r)) + region_pages(r));
+    }
+
+    for (r = 0;r < template.num_elf_regions;r ++) {
+        if (!region_writable(r)) {
+            continue;
+        }
+
+        n = region_pages(r);
+        caps = malloc(n * sizeof(seL4_CPtr));
+        assert(caps != NULL);
+        for (i = 0;i < n;i ++) {
+            caps[i] = template_dup(&template.vspace, region_start(r) + i * PAGE_SIZE_4K, seL4_CanRead);
+        }
+
+        template_copy[r] = vspace_map_pages(vspace, caps, NULL, seL4_CanRead, n, PAGE_BITS_4K, 1);
+        assert(template_copy[r] != NULL);
+        free(caps);
+    }
+
+    cow_pages = vspace_new_pages(vspace, seL4_AllRights, CLIENT_TEMPLATE_COW_PAGES, PAGE_BITS_4K);
+    if (cow_pages == NULL) {
+        printf("template: cannot allocate %d copy-on-write pages\n", CLIENT_TEMPLATE_COW_PAGES);
+        return -1;
+    }
+    for (i = 0;i < CLIENT_TEMPLATE_COW_PAGES;i ++) {
+        cow_caps[i] = template_dup(vspace, (seL4_Word) cow_pages + i * PAGE_SIZE_4K, seL4_AllRights);
+    }
+
+    error = vka_alloc_endpoint(vka, &template_fault_ep);
+    assert(error == 0);
+
+    error = sel4utils_configure_thread(vka, vspace, vspace, seL4_CapNull,
+                                       pager_priority, cspace, seL4_NilData, &template_pager);
+    assert(! error);
+    error = sel4utils_start_thread(&template_pager, template_pager_main, NULL, NULL, 1);
+    assert(! error);
+
+    return 0;
+}
+
+int
+client_template_configure(sel4utils_process_t *process, uint8_t priority)
+{
+    sel4utils_process_config_t config;
+    template_client_t *client;
+    cspacepath_t src, dest;
+    vka_object_t fault_ep;
+    seL4_Word vaddr;
+    seL4_CPtr cap;
+    int r, i, error;
+
+    if (template_client_num == CLIENT_MAX) {
+        printf("template: more than %d clients\n", CLIENT_MAX);
+        return -1;
+    }
+    client = &template_clients[template_client_num];
+
+    client->regions = malloc(template.num_elf_regions * sizeof(sel4utils_elf_region_t));
+    assert(client->regions != NULL);
+    client->pages = calloc(template_span, sizeof(seL4_CPtr));
+    assert(client->pages != NULL);
+    memcpy(client->regions, template.elf_regions, template.num_elf_regions * sizeof(sel4utils_elf_region_t));
+
+    /* the pager tells clients apart by the badge, index + 1 */
+    fault_ep = template_fault_ep;
+    vka_cspace_make_path(template_vka, template_fault_ep.cptr, &src);
+    error = vka_cspace_alloc(template_vka, &fault_ep.cptr);
+    assert(error == 0);
+    vka_cspace_make_path(template_vka, fault_ep.cptr, &dest);
+    error = vka_cnode_mint(&dest, &src, seL4_AllRights, seL4_CapData_Badge_new(template_client_num + 1));
+    assert(error == 0);
+
+    memset(&config, 0, sizeof(config));
+    config.is_elf = false;
+    config.entry_point = template.entry_point;
+    config.sysinfo = template.sysinfo;
+    config.create_cspace = true;
+    config.one_level_cspace_size_bits = CONFIG_SEL4UTILS_CSPACE_SIZE_BITS;
+    config.create_vspace = true;
+    config.reservations = client->regions;
+    config.num_reservations = template.num_elf_regions;
+    config.create_fault_endpoint = false;
+    config.fault_endpoint = fault_ep;
+    config.priority = priority;
+    config.asid_pool = seL4_CapInitThreadASIDPool;
+
+    error = sel4utils_configure_process_custom(process, template_vka, template_vspace, config);
+    if (error) {
+        return error;
+    }
+    process->pagesz = template.pagesz;
+    process->num_elf_regions = template.num_elf_regions;
+    process->elf_regions = client->regions;
+
+    /* every page starts out as the template's, read-only */
+    for (r = 0;r < template.num_elf_regions;r ++) {
+        for (i = 0;i < region_pages(r);i ++) {
+            vaddr = region_start(r) + i * PAGE_SIZE_4K;
+            /* a page two regions share is mapped once */
+            if (region_overlap(r, vaddr)) {
+                continue;
+            }
+
+            cap = template_dup(&template.vspace, vaddr, seL4_CanRead);
+            error = vspace_map_pages_at_vaddr(&process->vspace, &cap, NULL, (void *) vaddr, 1,
+                                              PAGE_BITS_4K, client->regions[r].reservation);
+            assert(error == 0);
+            client->pages[template_page(vaddr)] = cap;
+            template_shared ++;
+        }
+    }
+
+    client->pd = process->pd.cptr;
+    template_client_num ++;
+
+    return 0;
+}
+
+void
+client_template_report(void)
+{
+    printf("COLLECTION - template clients %d shared pages %d copied pages %d of %d\n",
+           template_client_num, template_shared, cow_used, CLIENT_TEMPLATE_COW_PAGES);
+}
@@ -0,0 +1,39 @@
+/*
+    Client processes cloned from a template image.
+
+    The client ELF is loaded once, into a template process that never
+    runs. A client made from it parses no ELF and copies no segments:
+    read-only regions map the template's frames, writable regions map
+    them read-only too and are copied page by page on the first write.
+
+    A client's faults go to a pager thread in the driver, on an endpoint
+    badged with the client's index. On a write to a shared page it
+    copies the template page into a frame from a reserve allocated up
+    front (the pager never calls the allocators, the driver may be
+    in the middle of using them), maps it writable and restarts the
+    client. Any other fault is printed and the client stays blocked.
+*/
+#ifndef CLIENT_TEMPLATE_H
+#define CLIENT_TEMPLATE_H
+
+#include <sel4/sel4.h>
+#include <sel4utils/process.h>
+#include <vka/vka.h>
+#include <vspace/vspace.h>
+
+/* copy-on-write frames shared by all clients, 4M by default */
+#ifndef CLIENT_TEMPLATE_COW_PAGES
+#define CLIENT_TEMPLATE_COW_PAGES 1024
+#endif
+
+/* Load image into the template and start the pager, 0 on success. */
+int client_template_init(vka_t *vka, vspace_t *vspace, seL4_CPtr cspace, const char *image,
+                         uint8_t pager_priority);
+
+/* Set up process from the template, in place of sel4utils_configure_process(). */
+int client_template_configure(sel4utils_process_t *process, uint8_t priority);
+
+/* COLLECTION - template line: clients, shared pages and copied pages */
+void client_template_report(void);
+
+#endif
@@ -0,0 +1,110 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "coroutine.h"
+
+static co_frame_t *co_frames;
+static co_frame_t *co_free;
+static int co_frame_num, co_used, co_peak, co_parks;
+
+int
+co_frames_init(allocman_t *allocman, int num)
+{
+    int i, error;
+
+    co_frames = calloc(num, sizeof(co_frame_t));
+    if (co_frames == NULL) {
+        printf("Error: Cannot allocate %d coroutine frames.\n", num);
+        return -1;
+    }
+
+    for (i = 0;i < num;i ++) {
+        error = allocman_cspace_alloc(allocman, &co_frames[i].slot);
+        if (error) {
+            printf("Error: Cannot allocate a reply slot for coroutine frame %d.\n", i);
+            return error;
+        }
+        co_frames[i].next = co_free;
+        co_free = &co_frames[i];
+    }
+    co_frame_num = num;
+
+    return 0;
+}
+
+co_frame_t *
+co_frame_alloc(int label)
+{
+    co_frame_t *f = co_free;
+
+    if (f == NULL) {
+        return NULL;
+    }
+    co_free = f->next;
+    if (++ co_used > co_peak) {
+        co_peak = co_used;
+    }
+
+    f->co_line = 0;
+    f->label = label;
+    f->next = NULL;
+
+    return f;
+}
+
+static void
+co_frame_reply(co_frame_t *f)
+{
+    seL4_Send(f->slot.offset, seL4_MessageInfo_new(f->label, 0, 0, 1));
+
+    f->next = co_free;
+    co_free = f;
+    co_used --;
+}
+
+int
+co_dispatch(co_handler_t handler, co_frame_t *f, co_queue_t *q)
+{
+    if (handler(f) == CO_DONE) {
+        co_frame_reply(f);
+        return CO_DONE;
+    }
+
+    if (q->tail != NULL) {
+        q->tail->next = f;
+    } else {
+        q->head = f;
+    }
+    q->tail = f;
+    co_parks ++;
+
+    return CO_WAIT;
+}
+
+int
+co_queue_resume(co_handler_t handler, co_queue_t *q)
+{
+    co_frame_t *f;
+    int done = 0;
+
+    /* the queue waits on one condition, if the oldest cannot go on neither can the rest */
+    while (q->head != NULL && handler(q->head) == CO_DONE) {
+        f = q->head;
+        q->head = f->next;
+        if (q->head == NULL) {
+            q->tail = NULL;
+        }
+        co_frame_reply(f);
+        done ++;
+    }
+
+    return done;
+}
+
+void
+co_frames_info(void)
+{
+    printf("COLLECTION - coroutine frames %d peak %d bytes %d parks %d\n",
+           co_frame_num, co_peak, (int) sizeof(co_frame_t), co_parks);
+}
@@ -0,0 +1,89 @@
+/*
+    Stackless request handlers.
+
+    A handler is a function over a co_frame_t that may stop at
+    CO_AWAIT(f, cond) points. When cond does not hold it returns
+    CO_WAIT with the resume point recorded in the frame; calling it
+    again continues right at that CO_AWAIT. Locals do not survive a
+    wait, keep anything needed afterwards in the frame. A handler body
+    must not itself use switch, the macros are built on one.
+
+        static int
+        co_consumer(co_frame_t *f)
+        {
+            CO_BEGIN(f);
+            CO_AWAIT(f, buffer > 0);
+            buffer --;
+            CO_END(f);
+        }
+
+    A waiting request is just its frame, with the caller's reply cap
+    saved in the frame's own slot, parked on a co_queue_t. The server
+    thread goes back to receiving, and whoever makes cond true resumes
+    the queue with co_queue_resume(), which replies for the handlers
+    that complete. Frames are preallocated together with their reply
+    slots.
+*/
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <allocman/allocman.h>
+#include <sel4/sel4.h>
+#include <vka/cspacepath_t.h>
+
+#ifndef CO_FRAMES
+#define CO_FRAMES 256
+#endif
+
+#define CO_DONE 0
+#define CO_WAIT 1
+
+typedef struct co_frame_t {
+    /* resume point, 0 before the first run */
+    int co_line;
+    /* request label, echoed in the reply */
+    int label;
+    /* the caller's reply cap */
+    cspacepath_t slot;
+    struct co_frame_t *next;
+} co_frame_t;
+
+typedef int (*co_handler_t)(co_frame_t *f);
+
+/* waiting requests, oldest first */
+typedef struct co_queue_t {
+    co_frame_t *head, *tail;
+} co_queue_t;
+
+#define CO_BEGIN(f) switch ((f)->co_line) { case 0:
+
+#define CO_AWAIT(f, cond)                   \
+    do {                                    \
+        (f)->co_line = __LINE__;            \
+        case __LINE__:                      \
+        if (!(cond)) {                      \
+            return CO_WAIT;                 \
+        }                                   \
+    } while (0)
+
+#define CO_END(f) } (f)->co_line = 0; return CO_DONE
+
+/* Allocate num frames and a reply slot for each, 0 on success. */
+int co_frames_init(allocman_t *allocman, int num);
+
+/* A frame for a new request, NULL if every frame is in use. The
+ * caller saves the reply cap in f->slot before dispatching. */
+co_frame_t *co_frame_alloc(int label);
+
+/* Run handler on a new frame: reply if it completes, otherwise park
+ * it on q. Returns CO_DONE or CO_WAIT. */
+int co_dispatch(co_handler_t handler, co_frame_t *f, co_queue_t *q);
+
+/* Resume the oldest frames of q while they complete and reply to
+ * them. Returns how many did. */
+int co_queue_resume(co_handler_t handler, co_queue_t *q);
+
+/* COLLECTION - coroutine line: frames, peak in use, bytes each, parks */
+void co_frames_info(void);
+
+#endif
@@ -0,0 +1,19 @@
+/*
+    Runs the green thread microbenchmarks (thread_bench.c) on the host.
+*/
+#include <host_sel4.h>
+
+#include "thread_lib.h"
+#include "thread_bench.h"
+
+static allocman_t host_allocman;
+static vspace_t host_vspace;
+
+int
+main(void)
+{
+    thread_initial();
+    thread_bench_run(&host_allocman, &host_vspace);
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+    In-process stand-in for the server endpoint.
+
+    Every simulated client has at most one request outstanding, as with
+    seL4_Call. Requests wait in a FIFO until the server receives them. A
+    reply (seL4_Reply, or seL4_Send on a cap saved with saveCaller) hands
+    the reply to the client callback, which returns the client's next
+    request. When the server receives on an empty queue no client can
+    make progress any more, so the run is over.
+*/
+#include <host_sel4.h>
+
+#define HOST_EP_MRS 4
+
+typedef struct host_msg_t {
+    int client;
+    seL4_MessageInfo_t info;
+    seL4_Word mrs[HOST_EP_MRS];
+} host_msg_t;
+
+static host_msg_t *queue;
+static int queue_size, queue_head, queue_num;
+
+static host_client_fn client_fn;
+static void (*done_fn)(void);
+
+/* client of the message being handled, -1 once replied or saved */
+static int caller = -1;
+/* client + 1 a saved reply cap answers, 0 if the slot is empty */
+static int reply_slots[HOST_EP_SLOTS];
+
+static int requests;
+
+static void
+host_ep_enqueue(int client, seL4_MessageInfo_t info, seL4_Word *mrs)
+{
+    host_msg_t *msg;
+
+    assert(queue_num < queue_size);
+
+    msg = &queue[(queue_head + queue_num) % queue_size];
+    msg->client = client;
+    msg->info = info;
+    memcpy(msg->mrs, mrs, sizeof(msg->mrs));
+    queue_num ++;
+}
+
+static void
+host_ep_deliver(int client, seL4_MessageInfo_t reply)
+{
+    seL4_Word mrs[HOST_EP_MRS] = {0};
+    seL4_MessageInfo_t next;
+
+    next = client_fn(client, reply, 0, mrs);
+    if (seL4_MessageInfo_get_label(next) != 0) {
+        host_ep_enqueue(client, next, mrs);
+    }
+}
+
+void
+host_ep_init(int clients, host_client_fn fn, void (*done)(void))
+{
+    seL4_MessageInfo_t none = seL4_MessageInfo_new(0, 0, 0, 0);
+    seL4_Word mrs[HOST_EP_MRS];
+    seL4_MessageInfo_t first;
+    int i;
+
+    queue = calloc(clients, sizeof(host_msg_t));
+    assert(queue != NULL);
+    queue_size = clients;
+    client_fn = fn;
+    done_fn = done;
+
+    for (i = 0;i < clients;i ++) {
+        memset(mrs, 0, sizeof(mrs));
+        first = client_fn(i, none, 1, mrs);
+        if (seL4_MessageInfo_get_label(first) != 0) {
+            host_ep_enqueue(i, first, mrs);
+        }
+    }
+}
+
+int
+host_ep_requests(void)
+{
+    return requests;
+}
+
+seL4_MessageInfo_t
+seL4_Recv(UNUSED seL4_CPtr src, seL4_Word *sender)
+{
+    host_msg_t *msg;
+
+    assert(src == HOST_EP);
+
+    if (queue_num == 0) {
+        if (done_fn != NULL) {
+            done_fn();
+        }
+        exit(0);
+    }
+
+    msg = &queue[queue_head];
+    queue_head = (queue_head + 1) % queue_size;
+    queue_num --;
+
+    memcpy(host_ipc_buffer.msg, msg->mrs, sizeof(msg->mrs));
+    caller = msg->client;
+    if (sender != NULL) {
+        *sender = msg->client;
+    }
+    requests ++;
+
+    return msg->info;
+}
+
+void
+seL4_Reply(seL4_MessageInfo_t info)
+{
+    int client = caller;
+
+    if (client < 0) {
+        return;
+    }
+    caller = -1;
+    host_ep_deliver(client, info);
+}
+
+seL4_MessageInfo_t
+seL4_ReplyRecv(seL4_CPtr src, seL4_MessageInfo_t info, seL4_Word *sender)
+{
+    seL4_Reply(info);
+
+    return seL4_Recv(src, sender);
+}
+
+void
+seL4_Send(seL4_CPtr dest, seL4_MessageInfo_t info)
+{
+    int client;
+
+    /* like the kernel, sending on an empty slot does nothing */
+    if (dest == HOST_EP || dest >= HOST_EP_SLOTS || reply_slots[dest] == 0) {
+        return;
+    }
+
+    client = reply_slots[dest] - 1;
+    reply_slots[dest] = 0;
+    host_ep_deliver(client, info);
+}
+
+int
+vka_cnode_saveCaller(const cspacepath_t *slot)
+{
+    assert(caller >= 0);
+    assert(slot->offset > HOST_EP && slot->offset < HOST_EP_SLOTS);
+
+    reply_slots[slot->offset] = caller + 1;
+    caller = -1;
+
+    return seL4_NoError;
+}
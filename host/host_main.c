@@ -0,0 +1,304 @@
+/*
+    Producer/consumer server of the driver (GREEN_THREAD, CONSUMER_PRODUCER,
+    THREAD_LOCK) running on the host against the simulated endpoint.
+
+    ./host_server32 [-c clients] [-n requests per client] [-t threads] [-b buffer limit]
+                    [-k items per request] [-s]
+
+    The clients follow the producer/consumer mix of workload.h (think
+    time and bursts are ignored) and then terminate. A sleeping request
+    holds its thread, so there have to be more threads than clients.
+    With -s the requests run as stackless handlers (coroutine.h, the
+    driver's CORO_HANDLERS) and any number of threads will do. With -k
+    a request moves up to that many items, as under the driver's
+    BATCH_OPS, and a client asks again for the items not moved yet.
+*/
+#include <unistd.h>
+
+#include <host_sel4.h>
+
+#include "thread_lib.h"
+#include "sync_prim.h"
+#include "thread_hooks.h"
+#include "coroutine.h"
+#include "workload.h"
+
+/* the message labels of lib_test.h that this server handles */
+enum {
+    HOST_PRODUCER = 1,
+    HOST_CONSUMER,
+    HOST_TMNT,
+};
+
+static allocman_t host_allocman;
+static vspace_t host_vspace;
+
+static workload_t workload;
+static int client_count = WORKLOAD_CLIENTS;
+static int request_num = WORKLOAD_OPS;
+static int thread_num = 8;
+static int stackless;
+static int batch = 1;
+
+static int buffer;
+static int buffer_limit = 1;
+static int wait_count;
+static thread_lock_t *lock_global, *producer_list, *consumer_list;
+
+static workload_client_t *clients;
+/* per client, items of the current batch not moved yet */
+static seL4_Word *batch_left;
+static uint64_t run_start;
+
+static seL4_MessageInfo_t
+host_client(int client, seL4_MessageInfo_t reply, int first, seL4_Word *mrs)
+{
+    uint64_t delay;
+
+    if (!first && seL4_MessageInfo_get_label(reply) == HOST_TMNT) {
+        return seL4_MessageInfo_new(0, 0, 0, 0);
+    }
+
+    mrs[0] = client;
+    if (batch > 1) {
+        /* the reply says how many items moved, ask again for the rest */
+        if (!first && batch_left[client] > 0) {
+            batch_left[client] -= seL4_GetMR(0);
+        }
+        if (!first && batch_left[client] > 0) {
+            mrs[1] = batch_left[client];
+            return seL4_MessageInfo_new(seL4_MessageInfo_get_label(reply), 0, 0, 2);
+        }
+        batch_left[client] = mrs[1] = batch;
+    }
+
+    switch (workload_next(&workload, &clients[client], &delay)) {
+        case WORKLOAD_KIND_PRODUCER:
+            return seL4_MessageInfo_new(HOST_PRODUCER, 0, 0, batch > 1 ? 2 : 1);
+        case WORKLOAD_KIND_CONSUMER:
+            return seL4_MessageInfo_new(HOST_CONSUMER, 0, 0, batch > 1 ? 2 : 1);
+    }
+
+    return seL4_MessageInfo_new(HOST_TMNT, 0, 0, 1);
+}
+
+static void
+host_done(void)
+{
+    uint64_t cycles = rdtsc() - run_start;
+    int requests = host_ep_requests();
+
+    printf("COLLECTION - host: clients %d threads %d requests %d cycles %llu per request %llu waits %d\n",
+           client_count, thread_num, requests, (unsigned long long)cycles,
+           (unsigned long long)(requests ? cycles / requests : 0), wait_count);
+    if (stackless) {
+        co_frames_info();
+    }
+    if (buffer != 0) {
+        printf("host: %d items left in the buffer, producers and consumers did not match\n", buffer);
+    }
+}
+
+static co_queue_t producer_frames, consumer_frames;
+
+static int
+co_producer(co_frame_t *f)
+{
+    CO_BEGIN(f);
+    CO_AWAIT(f, buffer < buffer_limit);
+    buffer ++;
+    CO_END(f);
+}
+
+static int
+co_consumer(co_frame_t *f)
+{
+    CO_BEGIN(f);
+    CO_AWAIT(f, buffer > 0);
+    buffer --;
+    CO_END(f);
+}
+
+static void
+co_request(co_handler_t handler, int label, co_queue_t *q)
+{
+    co_frame_t *f = co_frame_alloc(label);
+    int done;
+
+    assert(f != NULL);
+    vka_cnode_saveCaller(&f->slot);
+
+    if (co_dispatch(handler, f, q) == CO_WAIT) {
+        wait_count ++;
+        return;
+    }
+
+    do {
+        done = co_queue_resume(co_producer, &producer_frames);
+        done += co_queue_resume(co_consumer, &consumer_frames);
+    } while (done > 0);
+}
+
+/* 1: reply through the saved caller, 0: reply directly, -1: no reply */
+static int
+process_message(seL4_MessageInfo_t info, seL4_MessageInfo_t *reply)
+{
+    cspacepath_t *slot = &pool->t_running->t->slot;
+    int label = seL4_MessageInfo_get_label(info);
+    int count = 1, done, i;
+
+    if (seL4_MessageInfo_get_length(info) > 1) {
+        count = seL4_GetMR(1);
+    }
+
+    switch (label) {
+        case HOST_PRODUCER:
+            if (stackless) {
+                co_request(co_producer, HOST_PRODUCER, &producer_frames);
+                return -1;
+            }
+            vka_cnode_saveCaller(slot);
+            thread_lock_acquire(lock_global);
+
+            while (buffer == buffer_limit) {
+                thread_lock_release(lock_global);
+                thread_sleep(producer_list, NULL);
+                wait_count ++;
+                thread_lock_acquire(lock_global);
+            }
+
+            done = MIN(count, buffer_limit - buffer);
+            buffer += done;
+            for (i = 0;i < done;i ++) {
+                thread_wakeup(consumer_list, NULL);
+            }
+            thread_lock_release(lock_global);
+
+            seL4_SetMR(0, done);
+            *reply = seL4_MessageInfo_new(HOST_PRODUCER, 0, 0, 1);
+            return 1;
+
+        case HOST_CONSUMER:
+            if (stackless) {
+                co_request(co_consumer, HOST_CONSUMER, &consumer_frames);
+                return -1;
+            }
+            vka_cnode_saveCaller(slot);
+            thread_lock_acquire(lock_global);
+
+            while (buffer == 0) {
+                thread_lock_release(lock_global);
+                thread_sleep(consumer_list, NULL);
+                wait_count ++;
+                thread_lock_acquire(lock_global);
+            }
+
+            done = MIN(count, buffer);
+            buffer -= done;
+            for (i = 0;i < done;i ++) {
+                thread_wakeup(producer_list, NULL);
+            }
+            thread_lock_release(lock_global);
+
+            seL4_SetMR(0, done);
+            *reply = seL4_MessageInfo_new(HOST_CONSUMER, 0, 0, 1);
+            return 1;
+
+        case HOST_TMNT:
+            *reply = seL4_MessageInfo_new(HOST_TMNT, 0, 0, 1);
+            return 0;
+    }
+
+    return -1;
+}
+
+static void *
+server_loop(void *arg)
+{
+    seL4_MessageInfo_t info, reply;
+    int error, res;
+
+    error = allocman_cspace_alloc(&host_allocman, &pool->t_running->t->slot);
+    assert(error == 0);
+
+    info = seL4_Recv(HOST_EP, NULL);
+
+    while (1) {
+        res = process_message(info, &reply);
+        if (res == 1) {
+            seL4_Send(pool->t_running->t->slot.offset, reply);
+            info = seL4_Recv(HOST_EP, NULL);
+        } else if (res == 0) {
+            info = seL4_ReplyRecv(HOST_EP, reply, NULL);
+        } else {
+            info = seL4_Recv(HOST_EP, NULL);
+        }
+    }
+
+    return arg;
+}
+
+int
+main(int argc, char **argv)
+{
+    int opt, i, res;
+
+    while ((opt = getopt(argc, argv, "c:n:t:b:k:s")) != -1) {
+        switch (opt) {
+            case 'c': client_count = atoi(optarg); break;
+            case 'n': request_num = atoi(optarg); break;
+            case 't': thread_num = atoi(optarg); break;
+            case 'b': buffer_limit = atoi(optarg); break;
+            case 'k': batch = atoi(optarg); break;
+            case 's': stackless = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-c clients] [-n requests] [-t threads] [-b buffer] [-k items] [-s]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (stackless && batch > 1) {
+        fprintf(stderr, "host: the stackless handlers move one item per request\n");
+        return 1;
+    }
+
+    if (!stackless && thread_num <= client_count) {
+        fprintf(stderr, "host: need more threads (%d) than clients (%d)\n", thread_num, client_count);
+        return 1;
+    }
+
+    workload_default(&workload);
+    workload.clients = client_count;
+    workload.ops = request_num;
+    workload.mix[WORKLOAD_KIND_PRODUCER] = workload.mix[WORKLOAD_KIND_CONSUMER] = 1;
+    workload.mix[WORKLOAD_KIND_SEND_WAIT] = 0;
+
+    clients = calloc(client_count, sizeof(workload_client_t));
+    assert(clients != NULL);
+    batch_left = calloc(client_count, sizeof(seL4_Word));
+    assert(batch_left != NULL);
+    for (i = 0;i < client_count;i ++) {
+        workload_client_init(&workload, &clients[i], i);
+    }
+
+    thread_initial();
+    lock_global = thread_lock_create();
+    producer_list = thread_lock_create();
+    consumer_list = thread_lock_create();
+    if (stackless) {
+        res = co_frames_init(&host_allocman, client_count);
+        assert(res == 0);
+    }
+
+    /* the initial thread serves too */
+    for (i = 1;i < thread_num;i ++) {
+        res = thread_create(&host_allocman, &host_vspace, server_loop, NULL);
+        assert(res >= 0);
+    }
+
+    host_ep_init(client_count, host_client, host_done);
+    run_start = rdtsc();
+    server_loop(NULL);
+
+    return 0;
+}
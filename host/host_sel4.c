@@ -0,0 +1,38 @@
+#include <host_sel4.h>
+
+seL4_IPCBuffer host_ipc_buffer;
+
+/* cslots are only used as reply cap names, a counter is enough */
+int
+allocman_cspace_alloc(allocman_t *alloc, cspacepath_t *slot)
+{
+    if (alloc->next_slot == 0) {
+        /* slot 0 is the server endpoint */
+        alloc->next_slot = 1;
+    }
+    if (alloc->next_slot >= HOST_EP_SLOTS) {
+        return -1;
+    }
+
+    memset(slot, 0, sizeof(*slot));
+    slot->capPtr = alloc->next_slot;
+    slot->offset = alloc->next_slot;
+    alloc->next_slot ++;
+
+    return 0;
+}
+
+/* returns the top of the stack like the seL4 version; stacks are never freed */
+void *
+vspace_new_sized_stack(vspace_t *vspace, size_t n_pages)
+{
+    char *stack;
+
+    stack = aligned_alloc(PAGE_SIZE_4K, n_pages * PAGE_SIZE_4K);
+    if (stack == NULL) {
+        return NULL;
+    }
+    vspace->stack_pages += n_pages;
+
+    return stack + n_pages * PAGE_SIZE_4K;
+}
@@ -0,0 +1,7 @@
+/* host build: see host_sel4.h */
+#ifndef HOST_ALLOCMAN_VKA_H
+#define HOST_ALLOCMAN_VKA_H
+
+#include <host_sel4.h>
+
+#endif
@@ -0,0 +1,10 @@
+/* host build: no kernel configuration */
+#ifndef HOST_AUTOCONF_H
+#define HOST_AUTOCONF_H
+
+#define HAVE_AUTOCONF 1
+
+/* every x86 host has FXSAVE */
+#define CONFIG_FXSAVE 1
+
+#endif
@@ -0,0 +1,154 @@
+/*
+    Host (Linux userspace) stand-in for the parts of seL4, vka, vspace and
+    allocman that thread_lib.c and sync_prim.c use.
+
+    The headers under host/include shadow the staged seL4 headers and all
+    land here. Stacks come from malloc, cslots from a counter, and the
+    IPC calls go to an in-process endpoint (host_ep.c) fed by simulated
+    clients.
+*/
+#ifndef HOST_SEL4_H
+#define HOST_SEL4_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <autoconf.h>
+
+/* utils */
+#ifndef UNUSED
+#define UNUSED __attribute__((unused))
+#endif
+#ifndef ALIGN
+#define ALIGN(n) __attribute__((__aligned__(n)))
+#endif
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+#endif
+#define PAGE_BITS_4K 12
+#define PAGE_SIZE_4K (1ul << PAGE_BITS_4K)
+#define BYTES_TO_4K_PAGES(b) (((b) + PAGE_SIZE_4K - 1) / PAGE_SIZE_4K)
+
+/* seL4 */
+typedef uintptr_t seL4_Word;
+typedef seL4_Word seL4_CPtr;
+typedef seL4_Word seL4_CapRights_t;
+
+#define seL4_NoError 0
+#define seL4_AllRights 3
+#define seL4_CanRead 2
+#define seL4_MsgMaxLength 120
+#define seL4_MsgMaxExtraCaps 3
+
+typedef struct seL4_MessageInfo {
+    seL4_Word label;
+    seL4_Word caps;
+    seL4_Word extra;
+    seL4_Word length;
+} seL4_MessageInfo_t;
+
+static inline seL4_MessageInfo_t
+seL4_MessageInfo_new(seL4_Word label, seL4_Word caps, seL4_Word extra, seL4_Word length)
+{
+    seL4_MessageInfo_t info = { label, caps, extra, length };
+
+    return info;
+}
+
+static inline seL4_Word
+seL4_MessageInfo_get_label(seL4_MessageInfo_t info)
+{
+    return info.label;
+}
+
+static inline seL4_Word
+seL4_MessageInfo_get_length(seL4_MessageInfo_t info)
+{
+    return info.length;
+}
+
+static inline seL4_Word
+seL4_MessageInfo_get_extraCaps(seL4_MessageInfo_t info)
+{
+    return info.extra;
+}
+
+typedef struct seL4_IPCBuffer {
+    seL4_Word msg[seL4_MsgMaxLength];
+    seL4_Word caps_or_badges[seL4_MsgMaxExtraCaps];
+} seL4_IPCBuffer;
+
+/* IPC buffer of the one (green threaded) server thread */
+extern seL4_IPCBuffer host_ipc_buffer;
+
+static inline seL4_IPCBuffer *
+seL4_GetIPCBuffer(void)
+{
+    return &host_ipc_buffer;
+}
+
+static inline void
+seL4_SetMR(int i, seL4_Word mr)
+{
+    host_ipc_buffer.msg[i] = mr;
+}
+
+static inline seL4_Word
+seL4_GetMR(int i)
+{
+    return host_ipc_buffer.msg[i];
+}
+
+seL4_MessageInfo_t seL4_Recv(seL4_CPtr src, seL4_Word *sender);
+seL4_MessageInfo_t seL4_ReplyRecv(seL4_CPtr src, seL4_MessageInfo_t info, seL4_Word *sender);
+void seL4_Reply(seL4_MessageInfo_t info);
+void seL4_Send(seL4_CPtr dest, seL4_MessageInfo_t info);
+
+/* vka */
+typedef struct cspacepath_t {
+    seL4_CPtr root;
+    seL4_CPtr capPtr;
+    seL4_Word capDepth;
+    seL4_CPtr dest;
+    seL4_Word destDepth;
+    seL4_Word offset;
+    seL4_Word window;
+} cspacepath_t;
+
+int vka_cnode_saveCaller(const cspacepath_t *slot);
+
+/* allocman / vspace, only the calls the runtime makes */
+typedef struct allocman {
+    seL4_Word next_slot;
+} allocman_t;
+
+typedef struct vspace {
+    size_t stack_pages;
+} vspace_t;
+
+int allocman_cspace_alloc(allocman_t *alloc, cspacepath_t *slot);
+void *vspace_new_sized_stack(vspace_t *vspace, size_t n_pages);
+
+/* simulated endpoint, see host_ep.c */
+
+/* The server endpoint. Any cptr below HOST_EP_SLOTS is a saved reply cap. */
+#define HOST_EP 0
+#define HOST_EP_SLOTS 4096
+
+/* Called with the reply a client got (first == 1 before its first
+ * request). Returns the client's next request, with its message
+ * registers in mrs, or a label of 0 once the client is done. */
+typedef seL4_MessageInfo_t (*host_client_fn)(int client, seL4_MessageInfo_t reply, int first,
+                                             seL4_Word *mrs);
+
+void host_ep_init(int clients, host_client_fn client_fn, void (*done)(void));
+int host_ep_requests(void);
+
+#endif
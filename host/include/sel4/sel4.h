@@ -0,0 +1,7 @@
+/* host build: see host_sel4.h */
+#ifndef HOST_SEL4_SEL4_H
+#define HOST_SEL4_SEL4_H
+
+#include <host_sel4.h>
+
+#endif
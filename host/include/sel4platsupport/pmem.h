@@ -0,0 +1,7 @@
+/* host build: see host_sel4.h */
+#ifndef HOST_SEL4PLATSUPPORT_PMEM_H
+#define HOST_SEL4PLATSUPPORT_PMEM_H
+
+#include <host_sel4.h>
+
+#endif
@@ -0,0 +1,7 @@
+/* host build: see host_sel4.h */
+#ifndef HOST_SIMPLE_SIMPLE_H
+#define HOST_SIMPLE_SIMPLE_H
+
+#include <host_sel4.h>
+
+#endif
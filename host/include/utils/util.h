@@ -0,0 +1,7 @@
+/* host build: see host_sel4.h */
+#ifndef HOST_UTILS_UTIL_H
+#define HOST_UTILS_UTIL_H
+
+#include <host_sel4.h>
+
+#endif
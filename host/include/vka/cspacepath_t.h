@@ -0,0 +1,7 @@
+/* host build: see host_sel4.h */
+#ifndef HOST_VKA_CSPACEPATH_T_H
+#define HOST_VKA_CSPACEPATH_T_H
+
+#include <host_sel4.h>
+
+#endif
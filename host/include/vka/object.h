@@ -0,0 +1,7 @@
+/* host build: see host_sel4.h */
+#ifndef HOST_VKA_OBJECT_H
+#define HOST_VKA_OBJECT_H
+
+#include <host_sel4.h>
+
+#endif
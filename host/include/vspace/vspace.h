@@ -0,0 +1,7 @@
+/* host build: see host_sel4.h */
+#ifndef HOST_VSPACE_VSPACE_H
+#define HOST_VSPACE_VSPACE_H
+
+#include <host_sel4.h>
+
+#endif
@@ -0,0 +1,148 @@
+/*
+    Log-linear latency histogram, filled by a client and sent to the
+    driver in its TMNT message.
+
+    Values below LATENCY_HIST_LINEAR cycles get a bucket each. Above
+    that every power of two is split into four buckets, so a bucket is
+    at most 25% wide. The last bucket also takes everything beyond
+    2^25 cycles.
+
+    TMNT layout: MR0 client id, MR1 .. MR LATENCY_HIST_BUCKETS the
+    bucket counts. A TMNT of length 1 carries no histogram.
+*/
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sel4/sel4.h>
+
+#define LATENCY_HIST_LINEAR 8
+#define LATENCY_HIST_BUCKETS 96
+
+typedef struct latency_hist_t {
+    seL4_Word buckets[LATENCY_HIST_BUCKETS];
+} latency_hist_t;
+
+static inline int
+latency_hist_bucket(uint64_t cycles)
+{
+    int e, idx;
+
+    if (cycles < LATENCY_HIST_LINEAR) {
+        return (int) cycles;
+    }
+
+    e = 63 - __builtin_clzll(cycles);
+    idx = LATENCY_HIST_LINEAR + (e - 3) * 4 + (int) ((cycles >> (e - 2)) & 3);
+
+    return idx < LATENCY_HIST_BUCKETS ? idx : LATENCY_HIST_BUCKETS - 1;
+}
+
+/* largest value that falls into bucket idx */
+static inline uint64_t
+latency_hist_bucket_top(int idx)
+{
+    int e, sub;
+
+    if (idx < LATENCY_HIST_LINEAR) {
+        return idx;
+    }
+
+    e = (idx - LATENCY_HIST_LINEAR) / 4 + 3;
+    sub = (idx - LATENCY_HIST_LINEAR) % 4;
+
+    return ((uint64_t) (4 + sub + 1) << (e - 2)) - 1;
+}
+
+static inline void
+latency_hist_record(latency_hist_t *h, uint64_t cycles)
+{
+    h->buckets[latency_hist_bucket(cycles)] ++;
+}
+
+/* client side: put the histogram in the TMNT message, returns its length */
+static inline int
+latency_hist_to_msg(const latency_hist_t *h, seL4_Word client_id)
+{
+    int i;
+
+    seL4_SetMR(0, client_id);
+    for (i = 0;i < LATENCY_HIST_BUCKETS;i ++) {
+        seL4_SetMR(i + 1, h->buckets[i]);
+    }
+
+    return LATENCY_HIST_BUCKETS + 1;
+}
+
+/* driver side: add the histogram of a TMNT message, if it has one */
+static inline void
+latency_hist_from_msg(latency_hist_t *h, seL4_MessageInfo_t info)
+{
+    int i;
+
+    if (seL4_MessageInfo_get_length(info) < LATENCY_HIST_BUCKETS + 1) {
+        return;
+    }
+
+    for (i = 0;i < LATENCY_HIST_BUCKETS;i ++) {
+        h->buckets[i] += seL4_GetMR(i + 1);
+    }
+}
+
+static inline uint64_t
+latency_hist_count(const latency_hist_t *h)
+{
+    uint64_t count = 0;
+    int i;
+
+    for (i = 0;i < LATENCY_HIST_BUCKETS;i ++) {
+        count += h->buckets[i];
+    }
+
+    return count;
+}
+
+/* upper bound of the per-mille-th percentile, e.g. 990 for p99 */
+static inline uint64_t
+latency_hist_percentile(const latency_hist_t *h, int per_mille)
+{
+    uint64_t count = latency_hist_count(h), rank, seen = 0;
+    int i;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    rank = (count * per_mille + 999) / 1000;
+    for (i = 0;i < LATENCY_HIST_BUCKETS;i ++) {
+        seen += h->buckets[i];
+        if (seen >= rank && seen != 0) {
+            return latency_hist_bucket_top(i);
+        }
+    }
+
+    return latency_hist_bucket_top(LATENCY_HIST_BUCKETS - 1);
+}
+
+static inline void
+latency_hist_print(const latency_hist_t *h)
+{
+    uint64_t count = latency_hist_count(h);
+
+    if (count == 0) {
+        return;
+    }
+
+    printf("COLLECTION - latency count %llu p50 %llu p90 %llu p99 %llu p999 %llu max %llu\n",
+           (unsigned long long) count,
+           (unsigned long long) latency_hist_percentile(h, 500),
+           (unsigned long long) latency_hist_percentile(h, 900),
+           (unsigned long long) latency_hist_percentile(h, 990),
+           (unsigned long long) latency_hist_percentile(h, 999),
+           (unsigned long long) latency_hist_percentile(h, 1000));
+}
+
+#endif
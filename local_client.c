@@ -0,0 +1,147 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sel4utils/thread.h>
+#include <vka/capops.h>
+
+#include "local_client.h"
+#include "latency_hist.h"
+#include "lib_test.h"
+#ifdef CLIENT_BADGE
+#include "client_table.h"
+#endif
+
+static const seL4_Word local_labels[WORKLOAD_KINDS] = {
+    [WORKLOAD_KIND_PRODUCER] = PRODUCER,
+    [WORKLOAD_KIND_CONSUMER] = CONSUMER,
+    [WORKLOAD_KIND_SEND_WAIT] = SEND_WAIT,
+};
+
+/* PRODUCER/CONSUMER of w->batch items: MR1 asks for the items left,
+ * the reply says how many the server moved (a BATCH_OPS server) */
+static void
+local_client_batch(seL4_CPtr endpoint, seL4_Word id, int kind, seL4_Word batch)
+{
+    seL4_Word left = batch, done;
+
+    while (left > 0) {
+        seL4_SetMR(0, id);
+        seL4_SetMR(1, left);
+        seL4_Call(endpoint, seL4_MessageInfo_new(local_labels[kind], 0, 0, 2));
+
+        done = seL4_GetMR(0);
+        assert(done > 0 && done <= left);
+        left -= done;
+    }
+}
+
+static void
+local_client_main(void *arg0, void *arg1, void *ipc_buf UNUSED)
+{
+    sel4utils_thread_t *tcb = arg0;
+    seL4_CPtr endpoint = (seL4_CPtr) arg1;
+    workload_t workload, *w = &workload;
+    workload_client_t state;
+    seL4_MessageInfo_t info;
+    latency_hist_t hist;
+    uint64_t start, due, delay;
+    seL4_Word id;
+    int kind, len;
+    UNUSED int error;
+
+    memset(&hist, 0, sizeof(hist));
+
+    /* the INIT reply (after the barrier) carries our client id and the
+     * workload, as a spawned client gets them */
+    info = seL4_Call(endpoint, seL4_MessageInfo_new(INIT, 0, 0, 0));
+    id = seL4_GetMR(0);
+    error = workload_get_mrs(w, info, WORKLOAD_INIT_MR);
+    assert(error == 0);
+    workload_client_init(w, &state, id);
+
+    start = rdtsc();
+    while ((kind = workload_next(w, &state, &delay)) != WORKLOAD_KIND_DONE) {
+        due = w->interval ? workload_due(w, &state, start) : rdtsc() + delay;
+        while (rdtsc() < due) {
+            seL4_Yield();
+        }
+
+        if (w->batch > 1 && kind != WORKLOAD_KIND_SEND_WAIT) {
+            local_client_batch(endpoint, id, kind, w->batch);
+        } else {
+#ifdef CLIENT_BADGE
+            /* the badge tells the server who we are */
+            seL4_Call(endpoint, seL4_MessageInfo_new(local_labels[kind], 0, 0, 0));
+#else
+            seL4_SetMR(0, id);
+            seL4_Call(endpoint, seL4_MessageInfo_new(local_labels[kind], 0, 0, 1));
+#endif
+        }
+        latency_hist_record(&hist, rdtsc() - due);
+    }
+
+    /* the server does not answer TMNT */
+    len = latency_hist_to_msg(&hist, id);
+    seL4_Send(endpoint, seL4_MessageInfo_new(TMNT, 0, 0, len));
+
+    seL4_TCB_Suspend(tcb->tcb.cptr);
+}
+
+/* a copy of endpoint minted with badge */
+static seL4_CPtr
+local_client_cap(vka_t *vka, seL4_CPtr endpoint, seL4_Word badge)
+{
+    cspacepath_t src, dest;
+    seL4_CPtr badged;
+    UNUSED int error;
+
+    vka_cspace_make_path(vka, endpoint, &src);
+    error = vka_cspace_alloc(vka, &badged);
+    assert(error == 0);
+    vka_cspace_make_path(vka, badged, &dest);
+    error = vka_cnode_mint(&dest, &src, seL4_AllRights, seL4_CapData_Badge_new(badge));
+    assert(error == 0);
+
+    return badged;
+}
+
+int
+local_clients_start(vka_t *vka, vspace_t *vspace, seL4_CPtr cspace, seL4_CPtr endpoint,
+                    int num, uint8_t priority)
+{
+    sel4utils_thread_t *tcb;
+    seL4_CPtr badged = seL4_CapNull;
+    int i, error;
+
+    if (num == 0) {
+        return 0;
+    }
+
+#ifndef CLIENT_BADGE
+    /* one badged cap for all of them, like a spawned client gets */
+    badged = local_client_cap(vka, endpoint, LOCAL_CLIENT_BADGE);
+#endif
+
+    for (i = 0;i < num;i ++) {
+        tcb = malloc(sizeof(sel4utils_thread_t));
+        if (tcb == NULL) {
+            printf("Cannot allocate logical client %d.\n", i);
+            return i;
+        }
+
+#ifdef CLIENT_BADGE
+        /* a cap of its own, the server tells clients apart by badge */
+        badged = local_client_cap(vka, endpoint, client_badge_alloc());
+#endif
+
+        error = sel4utils_configure_thread(vka, vspace, vspace, seL4_CapNull,
+                                           priority, cspace, seL4_NilData, tcb);
+        assert(! error);
+
+        error = sel4utils_start_thread(tcb, local_client_main, tcb, (void *) badged, 1);
+        assert(! error);
+    }
+
+    return num;
+}
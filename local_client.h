@@ -0,0 +1,36 @@
+/*
+    Logical clients hosted in the driver itself.
+
+    Each one is a plain seL4 thread in the driver's vspace and cspace,
+    all sharing one badged copy of the server endpoint (one copy each,
+    with its own badge, under CLIENT_BADGE). Starting one
+    costs a TCB, a stack and an IPC buffer rather than a process spawn
+    and an ELF load, so a run can have hundreds of concurrent callers.
+    They speak the same protocol as the spawned clients: INIT, the
+    workload.h requests, then TMNT with their latency histogram.
+
+    A client waits for its next request by yielding until it is due. It
+    runs below the server's priority, so it only gets the CPU while the
+    server is blocked, and the yield lets another client whose request
+    is due go first.
+*/
+#ifndef LOCAL_CLIENT_H
+#define LOCAL_CLIENT_H
+
+#include <sel4/sel4.h>
+#include <vka/vka.h>
+#include <vspace/vspace.h>
+
+#include "workload.h"
+
+#define LOCAL_CLIENT_BADGE 0x61
+
+/* one below the servers, which run at seL4_MaxPrio */
+#define LOCAL_CLIENT_PRIORITY (seL4_MaxPrio - 1)
+
+/* Start num logical clients calling endpoint, returns how many started.
+ * They take their workload from the INIT reply. */
+int local_clients_start(vka_t *vka, vspace_t *vspace, seL4_CPtr cspace, seL4_CPtr endpoint,
+                        int num, uint8_t priority);
+
+#endif
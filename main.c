@@ -50,6 +50,25 @@
 #define TESTS_APP "sel4test-tests"
 
 #include "lib_test.h"
+/* first, so that the runtime calls below all go through the switch hooks */
+#include "thread_hooks.h"
+#include "thread_trace.h"
+#include "thread_stats.h"
+#include "thread_stack.h"
+#include "thread_slab.h"
+#include "thread_executor.h"
+#include "coroutine.h"
+#include "thread_handoff.h"
+#include "thread_fpu.h"
+#include "thread_msg.h"
+#include "server_stats.h"
+#include "thread_bench.h"
+#include "workload.h"
+#include "untyped_report.h"
+#include "latency_hist.h"
+#include "local_client.h"
+#include "client_template.h"
+#include "client_table.h"
 
 #include <sync/mutex.h>
 #include <sync/sem.h>
@@ -57,6 +76,11 @@
 #include <sync/bin_sem.h>
 #include <sel4bench/sel4bench.h>
 
+#ifdef CONFIG_BENCHMARK_TRACK_KERNEL_ENTRIES
+#include <sel4utils/benchmark_track.h>
+#include <sel4bench/kernel_logging.h>
+#endif
+
 /* ammount of untyped memory to reserve for the driver (32mb) */
 #define DRIVER_UNTYPED_MEMORY (1 << 25)
 /* Number of untypeds to try and use to allocate the driver memory.
@@ -83,7 +107,21 @@ static vka_object_t untypeds[CONFIG_MAX_NUM_BOOTINFO_UNTYPED_CAPS];
 static uint8_t untyped_size_bits_list[CONFIG_MAX_NUM_BOOTINFO_UNTYPED_CAPS];
 
 allocman_t *allocman;
+#ifdef CLIENT_BADGE
+/* reply caps live in the badge-indexed client table */
+#define CLIENT_REPLY_EP(client_id) (client_table[(client_id)].reply_ep)
+#else
 seL4_Word reply_eps[CLIENT_MAX];
+#define CLIENT_REPLY_EP(client_id) (reply_eps[(client_id)])
+#endif
+#if defined(GREEN_THREAD) && defined(THREAD_STATS)
+/* page the green thread accounting is exported into */
+static void *thread_stats_page;
+#endif
+
+/* server counters, moved into a shareable frame by init_server_stats() */
+static server_stats_t server_stats_early;
+server_stats_t *server_stats = &server_stats_early;
 
 #define IPCBUF_FRAME_SIZE_BITS 12
 #define IPCBUF_VADDR 0x7000000
@@ -92,6 +130,90 @@ seL4_Word reply_eps[CLIENT_MAX];
 
 seL4_CPtr ep_object;
 
+#ifdef FAST_UNTYPED_PARTITION
+/*
+    Split the bootinfo untypeds between the driver and the tests in one
+    pass, instead of probing the allocator size by size. Untypeds bigger
+    than PARTITION_UNTYPED_BITS are cut into pieces of that size, up to
+    CONFIG_RETYPE_FAN_OUT_LIMIT per retype, so that a big machine gives
+    the tests many untypeds rather than a few huge ones. Pieces go to the
+    driver until it has DRIVER_UNTYPED_MEMORY, then to the tests. Device
+    untypeds, pieces too small for a test and whatever is left once the
+    test list or the slots run out go to the driver's allocator.
+*/
+#ifndef PARTITION_UNTYPED_BITS
+#define PARTITION_UNTYPED_BITS 24
+#endif
+
+/* slots taken from the start of the empty region for the pieces */
+#define PARTITION_SLOTS (CONFIG_MAX_NUM_BOOTINFO_UNTYPED_CAPS + DRIVER_NUM_UNTYPEDS)
+
+static unsigned int partition_num_untypeds;
+
+static allocman_t *
+partition_untypeds(seL4_BootInfo *bi)
+{
+    seL4_CPtr next = bi->empty.start;
+    seL4_CPtr end = bi->empty.start + PARTITION_SLOTS;
+    size_t driver_bytes = 0;
+    allocman_t *alloc;
+    int error;
+
+    assert(end < bi->empty.end);
+    alloc = bootstrap_use_current_1level(seL4_CapInitThreadCNode, bi->initThreadCNodeSizeBits,
+                                         end, bi->empty.end, ALLOCATOR_STATIC_POOL_SIZE, allocator_mem_pool);
+    if (alloc == NULL) {
+        return NULL;
+    }
+
+    for (seL4_CPtr ut = bi->untyped.start; ut < bi->untyped.end; ut++) {
+        seL4_UntypedDesc *desc = &bi->untypedList[ut - bi->untyped.start];
+        size_t size_bits = desc->sizeBits;
+        seL4_CPtr first = ut;
+        seL4_Word pieces = 1;
+
+        if (!desc->isDevice && size_bits > PARTITION_UNTYPED_BITS &&
+            next + BIT(size_bits - PARTITION_UNTYPED_BITS) <= end) {
+            pieces = BIT(size_bits - PARTITION_UNTYPED_BITS);
+            for (seL4_Word done = 0; done < pieces; done += CONFIG_RETYPE_FAN_OUT_LIMIT) {
+                error = seL4_Untyped_Retype(ut, seL4_UntypedObject, PARTITION_UNTYPED_BITS,
+                                            seL4_CapInitThreadCNode, 0, 0, next + done,
+                                            MIN(pieces - done, CONFIG_RETYPE_FAN_OUT_LIMIT));
+                ZF_LOGF_IFERR(error, "Failed to split untyped %lu", (unsigned long) ut);
+            }
+            first = next;
+            next += pieces;
+            size_bits = PARTITION_UNTYPED_BITS;
+        }
+
+        for (seL4_Word i = 0; i < pieces; i++) {
+            cspacepath_t path = allocman_cspace_make_path(alloc, first + i);
+            uintptr_t paddr = desc->paddr + i * BIT(size_bits);
+
+            if (desc->isDevice || size_bits <= PAGE_BITS_4K || driver_bytes < DRIVER_UNTYPED_MEMORY ||
+                partition_num_untypeds == ARRAY_SIZE(untyped_size_bits_list)) {
+                error = allocman_utspace_add_uts(alloc, 1, &path, &size_bits, &paddr,
+                                                 desc->isDevice ? ALLOCMAN_UT_DEV : ALLOCMAN_UT_KERNEL);
+                ZF_LOGF_IFERR(error, "Failed to add untyped to the allocator");
+                if (!desc->isDevice) {
+                    driver_bytes += BIT(size_bits);
+                }
+            } else {
+                untypeds[partition_num_untypeds].cptr = first + i;
+                untypeds[partition_num_untypeds].type = seL4_UntypedObject;
+                untypeds[partition_num_untypeds].size_bits = size_bits;
+                partition_num_untypeds++;
+            }
+        }
+    }
+
+    error = allocman_fill_reserves(alloc);
+    ZF_LOGF_IFERR(error, "Failed to fill the allocator reserves");
+
+    return alloc;
+}
+#endif /* FAST_UNTYPED_PARTITION */
+
 /* initialise our runtime environment */
 static void
 init_env(env_t env)
@@ -100,7 +222,11 @@ init_env(env_t env)
     int error;
 
     /* create an allocator */
+#ifdef FAST_UNTYPED_PARTITION
+    allocman = partition_untypeds(platsupport_get_bootinfo());
+#else
     allocman = bootstrap_use_current_simple(&env->simple, ALLOCATOR_STATIC_POOL_SIZE, allocator_mem_pool);
+#endif
     if (allocman == NULL) {
         ZF_LOGF("Failed to create allocman");
     }
@@ -138,6 +264,7 @@ init_env(env_t env)
 
 
 
+#ifndef FAST_UNTYPED_PARTITION
 /* Free a list of objects */
 static void
 free_objects(vka_object_t *objects, unsigned int num)
@@ -168,24 +295,32 @@ allocate_untypeds(vka_object_t *untypeds, size_t bytes, unsigned int max_untyped
     }
     return num_untypeds;
 }
+#endif
 
 /* extract a large number of untypeds from the allocator */
 static unsigned int
 populate_untypeds(vka_object_t *untypeds)
 {
+#ifdef FAST_UNTYPED_PARTITION
+    /* split at bootstrap already, see partition_untypeds() */
+    unsigned int num_untypeds = partition_num_untypeds;
+#else
     /* First reserve some memory for the driver */
     vka_object_t reserve[DRIVER_NUM_UNTYPEDS];
     unsigned int reserve_num = allocate_untypeds(reserve, DRIVER_UNTYPED_MEMORY, DRIVER_NUM_UNTYPEDS);
 
     /* Now allocate everything else for the tests */
     unsigned int num_untypeds = allocate_untypeds(untypeds, UINT_MAX, ARRAY_SIZE(untyped_size_bits_list));
+#endif
     /* Fill out the size_bits list */
     for (unsigned int i = 0; i < num_untypeds; i++) {
         untyped_size_bits_list[i] = untypeds[i].size_bits;
     }
 
+#ifndef FAST_UNTYPED_PARTITION
     /* Return reserve memory */
     free_objects(reserve, reserve_num);
+#endif
 
     /* Return number of untypeds for tests */
     if (num_untypeds == 0) {
@@ -195,6 +330,7 @@ populate_untypeds(vka_object_t *untypeds)
     return num_untypeds;
 }
 
+#ifndef SHARED_UNTYPED_CNODE
 /* copy untyped caps into a processes cspace, return the cap range they can be found in */
 static seL4_SlotRegion
 copy_untypeds_to_process(sel4utils_process_t *process, vka_object_t *untypeds, int num_untypeds)
@@ -213,6 +349,131 @@ copy_untypeds_to_process(sel4utils_process_t *process, vka_object_t *untypeds, i
     assert((range.end - range.start) + 1 == num_untypeds);
     return range;
 }
+#else
+/*
+    The test untypeds, copied once into a CNode of their own. A test
+    process gets a two level cspace: a root with its usual cspace at
+    index 0 and this CNode at index 1. Its own slots keep their numbers
+    and the untypeds show up from BIT(CONFIG_SEL4UTILS_CSPACE_SIZE_BITS)
+    on, so handing them over is a few caps whatever their number.
+
+    Revoking an untyped also deletes its copies, so between tests the
+    driver revokes the copies in this CNode rather than the originals.
+*/
+#define UNTYPED_ROOT_BITS 1
+#define UNTYPED_ROOT_GUARD (seL4_WordBits - UNTYPED_ROOT_BITS - CONFIG_SEL4UTILS_CSPACE_SIZE_BITS)
+
+static vka_object_t untyped_cnode;
+/* root cnode of the running test, one test runs at a time */
+static vka_object_t untyped_root;
+
+static void
+untyped_cnode_path(vka_object_t *cnode, seL4_Word index, cspacepath_t *path)
+{
+    memset(path, 0, sizeof(*path));
+    path->root = cnode->cptr;
+    path->capPtr = index;
+    path->capDepth = cnode->size_bits;
+}
+
+static void
+init_untyped_cnode(void)
+{
+    cspacepath_t src, dest;
+    uint32_t bits = 1;
+    UNUSED int error;
+
+    while (BIT(bits) < num_untypeds) {
+        bits++;
+    }
+
+    error = vka_alloc_cnode_object(&env.vka, bits, &untyped_cnode);
+    assert(error == 0);
+
+    for (int i = 0; i < num_untypeds; i++) {
+        vka_cspace_make_path(&env.vka, untypeds[i].cptr, &src);
+        untyped_cnode_path(&untyped_cnode, i, &dest);
+        error = vka_cnode_copy(&dest, &src, seL4_AllRights);
+        assert(error == 0);
+    }
+}
+
+/* give a process the shared untypeds, return the cap range they can be found in */
+static seL4_SlotRegion
+share_untypeds_with_process(sel4utils_process_t *process, seL4_CPtr *root_cnode)
+{
+    seL4_SlotRegion range;
+    cspacepath_t src, dest;
+    UNUSED int error;
+
+    error = vka_alloc_cnode_object(&env.vka, UNTYPED_ROOT_BITS, &untyped_root);
+    assert(error == 0);
+
+    /* index 0: the process' own cspace, no guard so that its slots keep their numbers */
+    vka_cspace_make_path(&env.vka, process->cspace.cptr, &src);
+    untyped_cnode_path(&untyped_root, 0, &dest);
+    error = vka_cnode_mint(&dest, &src, seL4_AllRights, seL4_CapData_Guard_new(0, 0));
+    assert(error == 0);
+
+    /* index 1: the untypeds, guarded to take the same bits as the own cspace */
+    vka_cspace_make_path(&env.vka, untyped_cnode.cptr, &src);
+    untyped_cnode_path(&untyped_root, 1, &dest);
+    error = vka_cnode_mint(&dest, &src, seL4_AllRights,
+                           seL4_CapData_Guard_new(0, CONFIG_SEL4UTILS_CSPACE_SIZE_BITS - untyped_cnode.size_bits));
+    assert(error == 0);
+
+    error = seL4_TCB_SetSpace(process->thread.tcb.cptr, SEL4UTILS_ENDPOINT_SLOT,
+                              untyped_root.cptr, seL4_CapData_Guard_new(0, UNTYPED_ROOT_GUARD),
+                              process->pd.cptr, seL4_NilData);
+    assert(error == 0);
+
+    /* the test's CNode operations have to start from the new root too */
+    vka_cspace_make_path(&env.vka, untyped_root.cptr, &src);
+    *root_cnode = sel4utils_mint_cap_to_process(process, src, seL4_AllRights,
+                                                seL4_CapData_Guard_new(0, UNTYPED_ROOT_GUARD));
+    assert(*root_cnode != 0);
+
+    range.start = BIT(CONFIG_SEL4UTILS_CSPACE_SIZE_BITS);
+    range.end = range.start + num_untypeds - 1;
+    return range;
+}
+#endif /* SHARED_UNTYPED_CNODE */
+
+/* untypeds the test that just finished may have retyped */
+static seL4_Word untyped_dirty[UNTYPED_REPORT_WORDS];
+
+/* A test that sent its result with untyped_report_send() retyped only
+ * the untypeds in its bitmap. Without a report, or after a fault, all
+ * of them count as used. Call before the MRs are overwritten. */
+static void
+mark_untypeds_used(seL4_MessageInfo_t info)
+{
+    int report = untyped_report_is(info);
+
+    for (int i = 0; i < UNTYPED_REPORT_WORDS; i++) {
+        untyped_dirty[i] |= report ? seL4_GetMR(2 + i) : ~(seL4_Word) 0;
+    }
+}
+
+/* revoke the untypeds marked used, deleting everything made from them */
+static void
+reset_untypeds(void)
+{
+    for (int i = 0; i < num_untypeds; i++) {
+        cspacepath_t path;
+
+        if (!(untyped_dirty[i / seL4_WordBits] & BIT(i % seL4_WordBits))) {
+            continue;
+        }
+#ifdef SHARED_UNTYPED_CNODE
+        untyped_cnode_path(&untyped_cnode, i, &path);
+#else
+        vka_cspace_make_path(&env.vka, untypeds[i].cptr, &path);
+#endif
+        vka_cnode_revoke(&path);
+    }
+    memset(untyped_dirty, 0, sizeof(untyped_dirty));
+}
 
 /* map the init data into the process, and send the address via ipc */
 static void *
@@ -261,6 +522,133 @@ copy_serial_caps(test_init_data_t *init, env_t env, sel4utils_process_t *test_pr
     arch_copy_serial_caps(init, env, test_process);
 }
 
+#ifdef CONFIG_BENCHMARK_TRACK_KERNEL_ENTRIES
+
+/* name of the server configuration being measured, used to tag the report */
+#if defined(GREEN_THREAD)
+#define SERVER_THREAD_NAME "green"
+#elif defined(SEL4_THREAD)
+#define SERVER_THREAD_NAME "sel4"
+#else
+#define SERVER_THREAD_NAME "unknown"
+#endif
+
+#if defined(CONSUMER_PRODUCER)
+#define SERVER_MODE_NAME "PRODUCER/CONSUMER"
+#else
+#define SERVER_MODE_NAME "SEND_WAIT"
+#endif
+
+/* the kernel stores the negated syscall number in a 4 bit field */
+#define KERNEL_TRACK_NUM_SYSCALLS 16
+
+static const char *kernel_track_syscall_names[KERNEL_TRACK_NUM_SYSCALLS] = {
+    [-seL4_SysCall] = "Call",
+    [-seL4_SysReplyRecv] = "ReplyRecv",
+    [-seL4_SysSend] = "Send",
+    [-seL4_SysNBSend] = "NBSend",
+    [-seL4_SysRecv] = "Recv",
+    [-seL4_SysReply] = "Reply",
+    [-seL4_SysYield] = "Yield",
+    [-seL4_SysNBRecv] = "NBRecv",
+};
+
+/* kernel entry log, a large frame shared with the kernel */
+static benchmark_track_kernel_entry_t *kernel_log;
+/* number of server operations issued since the log was last reset */
+static unsigned int kernel_track_ops;
+
+/* give the kernel a large frame to log kernel entries into */
+static void
+kernel_track_init(env_t env)
+{
+    vka_object_t frame;
+    int error;
+
+    error = vka_alloc_frame(&env->vka, seL4_LargePageBits, &frame);
+    ZF_LOGF_IFERR(error, "Failed to allocate kernel log frame");
+
+    kernel_log = vspace_map_pages(&env->vspace, &frame.cptr, NULL, seL4_AllRights, 1, seL4_LargePageBits, 1);
+    ZF_LOGF_IF(kernel_log == NULL, "Failed to map kernel log frame");
+
+    error = seL4_BenchmarkSetLogBuffer(frame.cptr);
+    ZF_LOGF_IFERR(error, "Failed to set kernel log buffer");
+}
+
+/* start tracking once every client has been released from the barrier */
+static void
+kernel_track_start(void)
+{
+    kernel_track_ops = 0;
+    seL4_BenchmarkResetLog();
+}
+
+/* count one PRODUCER/CONSUMER/SEND_WAIT operation against the log */
+static inline void
+kernel_track_op(void)
+{
+    kernel_track_ops ++;
+}
+
+/* stop tracking and report per-syscall counts and in-kernel cycles */
+static void
+kernel_track_dump(void)
+{
+    uint32_t counts[KERNEL_TRACK_NUM_SYSCALLS] = {0};
+    uint32_t fastpath[KERNEL_TRACK_NUM_SYSCALLS] = {0};
+    uint64_t cycles[KERNEL_TRACK_NUM_SYSCALLS] = {0};
+    uint32_t others = 0;
+    uint64_t other_cycles = 0;
+    size_t max_entries = BIT(seL4_LargePageBits) / sizeof(benchmark_track_kernel_entry_t);
+
+    seL4_Word num_entries = seL4_BenchmarkFinalizeLog();
+    if (num_entries > max_entries) {
+        num_entries = max_entries;
+    }
+
+    for (seL4_Word i = 0; i < num_entries; i++) {
+        benchmark_track_kernel_entry_t *entry = &kernel_log[i];
+
+        if (entry->entry.path != Entry_Syscall) {
+            others ++;
+            other_cycles += entry->duration;
+            continue;
+        }
+
+        counts[entry->entry.syscall_no] ++;
+        cycles[entry->entry.syscall_no] += entry->duration;
+        fastpath[entry->entry.syscall_no] += entry->entry.is_fastpath;
+    }
+
+    printf("COLLECTION - kernel %s %s: %u ops %u entries\n", SERVER_THREAD_NAME, SERVER_MODE_NAME,
+           kernel_track_ops, num_entries);
+
+    for (int i = 0; i < KERNEL_TRACK_NUM_SYSCALLS; i++) {
+        if (counts[i] == 0) {
+            continue;
+        }
+
+        printf("COLLECTION - kernel %-10s count: %u fastpath: %u cycles: %llu avg: %llu per op: %u.%02u\n",
+               kernel_track_syscall_names[i] ? kernel_track_syscall_names[i] : "Other",
+               counts[i], fastpath[i], cycles[i], cycles[i] / counts[i],
+               kernel_track_ops ? counts[i] / kernel_track_ops : 0,
+               kernel_track_ops ? (counts[i] * 100 / kernel_track_ops) % 100 : 0);
+    }
+
+    if (others) {
+        printf("COLLECTION - kernel %-10s count: %u cycles: %llu\n", "non-syscall", others, other_cycles);
+    }
+}
+
+#else
+
+static inline void kernel_track_init(env_t env UNUSED) {}
+static inline void kernel_track_start(void) {}
+static inline void kernel_track_op(void) {}
+static inline void kernel_track_dump(void) {}
+
+#endif /* CONFIG_BENCHMARK_TRACK_KERNEL_ENTRIES */
+
 /* Run a single test.
  * Each test is launched as its own process. */
 int
@@ -293,7 +681,11 @@ run_test(struct testcase *test)
 #endif
     env.init->cores = simple_get_core_count(&env.simple);
     /* setup data about untypeds */
+#ifdef SHARED_UNTYPED_CNODE
+    env.init->untypeds = share_untypeds_with_process(&test_process, &env.init->root_cnode);
+#else
     env.init->untypeds = copy_untypeds_to_process(&test_process, untypeds, num_untypeds);
+#endif
     copy_timer_caps(env.init, &env, &test_process);
     copy_serial_caps(env.init, &env, &test_process);
     /* copy the fault endpoint - we wait on the endpoint for a message
@@ -303,7 +695,12 @@ run_test(struct testcase *test)
     /* WARNING: DO NOT COPY MORE CAPS TO THE PROCESS BEYOND THIS POINT,
      * AS THE SLOTS WILL BE CONSIDERED FREE AND OVERRIDDEN BY THE TEST PROCESS. */
     /* set up free slot range */
+#ifdef SHARED_UNTYPED_CNODE
+    /* the root level comes on top of the process' own cspace */
+    env.init->cspace_size_bits = CONFIG_SEL4UTILS_CSPACE_SIZE_BITS + UNTYPED_ROOT_BITS;
+#else
     env.init->cspace_size_bits = CONFIG_SEL4UTILS_CSPACE_SIZE_BITS;
+#endif
     env.init->free_slots.start = endpoint + 1;
     env.init->free_slots.end = (1u << CONFIG_SEL4UTILS_CSPACE_SIZE_BITS);
     assert(env.init->free_slots.start < env.init->free_slots.end);
@@ -330,6 +727,7 @@ run_test(struct testcase *test)
 
     /* wait on it to finish or fault, report result */
     seL4_MessageInfo_t info = seL4_Recv(test_process.fault_endpoint.cptr, NULL);
+    mark_untypeds_used(info);
 
     int result = seL4_GetMR(0);
     if (seL4_MessageInfo_get_label(info) != seL4_Fault_NullFault) {
@@ -341,21 +739,229 @@ run_test(struct testcase *test)
     /* unmap the env.init data frame */
     vspace_unmap_pages(&test_process.vspace, remote_vaddr, 1, PAGE_BITS_4K, NULL);
 
-    /* reset all the untypeds for the next test */
-    for (int i = 0; i < num_untypeds; i++) {
-        cspacepath_t path;
-        vka_cspace_make_path(&env.vka, untypeds[i].cptr, &path);
-        vka_cnode_revoke(&path);
-    }
-
     /* destroy the process */
     sel4utils_destroy_process(&test_process, &env.vka);
+#ifdef SHARED_UNTYPED_CNODE
+    vka_free_object(&env.vka, &untyped_root);
+#endif
+    reset_untypeds();
 
     test_assert(result == SUCCESS);
     return result;
 }
 
 
+/* workload of this run, kept in the init frame so that clients see it */
+static workload_t *workload;
+
+static void
+init_workload(void)
+{
+    UNUSED int error;
+
+    compile_time_assert(workload_fits_in_init_frame,
+                        WORKLOAD_INIT_OFFSET + sizeof(workload_t) <= PAGE_SIZE_4K);
+
+    workload = (workload_t *) ((uintptr_t) env.init + WORKLOAD_INIT_OFFSET);
+    workload_default(workload);
+#ifdef CLIENT_BADGE
+    error = client_table_init(workload->clients);
+    assert(error == 0);
+#else
+    assert(workload->clients <= CLIENT_MAX);
+#endif
+    assert(workload->local <= workload->clients);
+
+    printf("COLLECTION - workload clients %lu local %lu ops %lu mix %lu/%lu/%lu think %lu burst %lu gap %lu interval %lu batch %lu\n",
+           (unsigned long) workload->clients, (unsigned long) workload->local,
+           (unsigned long) workload->ops,
+           (unsigned long) workload->mix[WORKLOAD_KIND_PRODUCER],
+           (unsigned long) workload->mix[WORKLOAD_KIND_CONSUMER],
+           (unsigned long) workload->mix[WORKLOAD_KIND_SEND_WAIT],
+           (unsigned long) workload->think, (unsigned long) workload->burst,
+           (unsigned long) workload->burst_gap, (unsigned long) workload->interval,
+           (unsigned long) workload->batch);
+}
+
+/* client side latencies, merged from the TMNT messages */
+static latency_hist_t latency_total;
+
+/* a batching client trusts the count in MR0 of the reply, which only the
+ * BATCH_OPS handlers send; the stackless handlers move one item each */
+#if WORKLOAD_BATCH > 1 && (!defined(BATCH_OPS) || defined(CORO_HANDLERS))
+#error "WORKLOAD_BATCH > 1 needs BATCH_OPS without CORO_HANDLERS"
+#endif
+
+#ifdef BATCH_OPS
+/*
+    Batched PRODUCER/CONSUMER requests. A request longer than one word
+    asks for MR1 items. The server moves as many as the buffer allows in
+    one pass under one lock acquisition, sleeping only while it can move
+    none, and replies with the number moved in MR0. The client asks
+    again for the rest. A one-word request is a single item, as before.
+*/
+#define BATCH_COUNT_MR 1
+
+/* buffer room for batches, buffer_limit is 1 otherwise */
+#ifndef BATCH_BUFFER
+#define BATCH_BUFFER 64
+#endif
+
+static seL4_Word batch_requests, batch_items;
+
+/* items a request asks for, read before anything reuses the MRs */
+static inline int
+batch_count(seL4_MessageInfo_t info)
+{
+    int count;
+
+    if (seL4_MessageInfo_get_length(info) <= BATCH_COUNT_MR) {
+        return 1;
+    }
+    count = seL4_GetMR(BATCH_COUNT_MR);
+
+    return count > 0 ? count : 1;
+}
+
+/* reply to a batch that moved done items */
+static inline seL4_MessageInfo_t
+batch_reply(int label, int done)
+{
+    batch_requests ++;
+    batch_items += done;
+
+    seL4_SetMR(0, done);
+    return seL4_MessageInfo_new(label, 0, 0, 1);
+}
+#endif
+
+#ifdef BENCHMARK_ENTIRE
+/* one row of the client count sweep, see sweep_table.py */
+static void
+workload_report(uint64_t cycles)
+{
+    seL4_Word requests = server_stats->producer + server_stats->consumer +
+                         server_stats->wait + server_stats->send_wait;
+
+    printf("COLLECTION - throughput clients %d requests %lu cycles %llu\n",
+           client_count, (unsigned long) requests, cycles);
+#ifdef CLIENT_TEMPLATE
+    client_template_report();
+#endif
+#ifdef CLIENT_BADGE
+    client_table_info();
+#endif
+#ifdef BATCH_OPS
+    printf("COLLECTION - batch requests %lu items %lu\n",
+           (unsigned long) batch_requests, (unsigned long) batch_items);
+#endif
+}
+#endif
+
+#ifdef GREEN_THREAD
+/* the COLLECTION lines of the green runtime, once every client has sent TMNT */
+static void *
+green_report_task(void *arg)
+{
+    kernel_track_dump();
+    latency_hist_print(&latency_total);
+    thread_trace_dump();
+#ifdef THREAD_STATS
+    thread_stats_snapshot(thread_stats_page, PAGE_SIZE_4K);
+    thread_stats_pool_info();
+#endif
+    thread_stack_pool_info();
+    thread_slab_pool_info();
+    thread_fpu_info();
+#ifdef THREAD_MSG
+    thread_msg_info();
+#endif
+#ifdef EXECUTOR
+    executor_info();
+#endif
+#ifdef CORO_HANDLERS
+    co_frames_info();
+#endif
+
+    return arg;
+}
+
+/* Under EXECUTOR the report runs on a parked worker, so the handler that
+ * sees the last TMNT needs no stack for the printing. */
+static void
+green_report(void)
+{
+#ifdef EXECUTOR
+    executor_future_t *f = executor_submit(green_report_task, NULL);
+
+    future_wait(f);
+    future_release(f);
+#else
+    green_report_task(NULL);
+#endif
+}
+#endif
+
+/* Move the server counters into a frame of their own so that they can be
+ * shared with the clients. */
+static void
+init_server_stats(void)
+{
+    server_stats_t *page = vspace_new_pages(&env.vspace, seL4_AllRights, 1, PAGE_BITS_4K);
+    assert(page != NULL);
+
+    *page = *server_stats;
+    page->magic = SERVER_STATS_MAGIC;
+    page->version = SERVER_STATS_VERSION;
+    server_stats = page;
+}
+
+/* Map the server counters read-only into a client, returns the address
+ * in the client's vspace. */
+static void *
+map_server_stats(sel4utils_process_t *process)
+{
+    cspacepath_t src, dest;
+    seL4_CPtr cap;
+    void *vaddr;
+    int error;
+
+    vka_cspace_make_path(&env.vka, vspace_get_cap(&env.vspace, server_stats), &src);
+    error = vka_cspace_alloc(&env.vka, &cap);
+    assert(error == 0);
+    vka_cspace_make_path(&env.vka, cap, &dest);
+    error = vka_cnode_copy(&dest, &src, seL4_CanRead);
+    assert(error == 0);
+
+    vaddr = vspace_map_pages(&process->vspace, &cap, NULL, seL4_CanRead, 1, PAGE_BITS_4K, 1);
+    assert(vaddr != NULL);
+
+    return vaddr;
+}
+
+/* Set up a client process, cloned from the template under CLIENT_TEMPLATE. */
+static int
+configure_client(sel4utils_process_t *process)
+{
+#ifdef CLIENT_TEMPLATE
+    return client_template_configure(process, env.init->priority);
+#else
+    return sel4utils_configure_process(process, &env.vka, &env.vspace,
+                                       env.init->priority, TESTS_APP);
+#endif
+}
+
+/* Badge of a new client's endpoint cap, one per client under CLIENT_BADGE. */
+static seL4_Word
+client_ep_badge(void)
+{
+#ifdef CLIENT_BADGE
+    return client_badge_alloc();
+#else
+    return 0X61;
+#endif
+}
+
 /* Run a client process.
  * Modification based on run_    seL4_MessageInfo_t info = seL4_MessageInfo_new(seL4_Fault_NullFault, 0, 0, 1);
 test() */
@@ -368,8 +974,7 @@ run_test_new(char *client_name)
     /* Test intro banner. */
     printf("  %s\n", client_name);
 
-    error = sel4utils_configure_process(&test_process, &env.vka, &env.vspace,
-                                        env.init->priority, TESTS_APP);
+    error = configure_client(&test_process);
     assert(error == 0);
 
     /* set up caps about the process */
@@ -400,7 +1005,7 @@ run_test_new(char *client_name)
     seL4_CPtr endpoint;
     vka_cspace_make_path(&env.vka, env.endpoint.cptr, &ep_cap_path);
 
-    endpoint = sel4utils_mint_cap_to_process(&test_process, ep_cap_path, seL4_AllRights, seL4_CapData_Badge_new(0X61));
+    endpoint = sel4utils_mint_cap_to_process(&test_process, ep_cap_path, seL4_AllRights, seL4_CapData_Badge_new(client_ep_badge()));
     printf("initial: %d %d\n", endpoint, env.endpoint.cptr);
     /* WARNING: DO NOT COPY MORE CAPS TO THE PROCESS BEYOND THIS POINT,
      * AS THE SLOTS WILL BE CONSIDERED FREE AND OVERRIDDEN BY THE TEST PROCESS. */
@@ -418,31 +1023,27 @@ run_test_new(char *client_name)
 //#endif
 
     /* set up args for the test process */
+    /* map env.init_data (and the workload in it) into the new process */
+    void *remote_vaddr = send_init_data(&env, test_process.fault_endpoint.cptr, &test_process);
+
     char endpoint_string[WORD_STRING_SIZE];
+    char stats_string[WORD_STRING_SIZE];
+    char init_string[WORD_STRING_SIZE];
     char sel4test_name[] = { TESTS_APP };
-    char *argv[] = {sel4test_name, endpoint_string};
+    char *argv[] = {sel4test_name, endpoint_string, stats_string, init_string};
     snprintf(endpoint_string, WORD_STRING_SIZE, "%lu", (unsigned long)endpoint);
+    snprintf(stats_string, WORD_STRING_SIZE, "%lu", (unsigned long)map_server_stats(&test_process));
+    snprintf(init_string, WORD_STRING_SIZE, "%lu", (unsigned long)remote_vaddr);
 
     /* spawn the process */
     error = sel4utils_spawn_process_v(&test_process, &env.vka, &env.vspace,
                             ARRAY_SIZE(argv), argv, 1);
     assert(error == 0);
 
-    /* send env.init_data to the new process */
-    void *remote_vaddr = send_init_data(&env, test_process.fault_endpoint.cptr, &test_process);
-
-    /* wait on it to finish or fault, report result */
+    /* the client runs on after this returns and reads its workload from
+     * the init frame (argv[3]), so leave the frame mapped */
 
-
-    /* unmap the env.init data frame */
-    vspace_unmap_pages(&test_process.vspace, remote_vaddr, 1, PAGE_BITS_4K, NULL);
-
-    /* reset all the untypeds for the next test */
-    for (int i = 0; i < num_untypeds; i++) {
-        cspacepath_t path;
-        vka_cspace_make_path(&env.vka, untypeds[i].cptr, &path);
-        vka_cnode_revoke(&path);
-    }
+    /* clients get no untypeds, there is nothing to revoke */
 
     /* destroy the process */
     //sel4utils_destroy_process(&test_process, &env.vka);
@@ -451,7 +1052,35 @@ run_test_new(char *client_name)
     return SUCCESS;
 }
 
+/* Spawn num client processes, sel4test_run_tests_new() always starts two. */
+static void
+run_clients(int num)
+{
+    char client_name[TEST_NAME_MAX];
+    int i;
+
+    sel4test_start_suite("sel4test");
+    for (i = 0;i < num;i ++) {
+        snprintf(client_name, sizeof(client_name), "client %02d", i + 1);
+        run_test_new(client_name);
+    }
+    sel4test_end_suite();
+}
+
+
 
+/* The INIT reply: MR0 the client's id, MR1 set for client 0, and the
+ * workload from WORKLOAD_INIT_MR on, so a client needs nothing else to
+ * generate its requests. */
+static seL4_MessageInfo_t
+client_init_reply(int client_id)
+{
+    seL4_SetMR(0, client_id);
+    seL4_SetMR(1, client_id == 0);
+    workload_set_mrs(workload, WORKLOAD_INIT_MR);
+
+    return seL4_MessageInfo_new(INIT, 0, 0, WORKLOAD_INIT_MR + WORKLOAD_WORDS);
+}
 
 /*
     if received initial data from all clients, multicast responses to all of them.
@@ -462,17 +1091,91 @@ process_message_multicast()
     int i;
     seL4_MessageInfo_t reply;
 
-    for (i = 1;i < client_num;i ++) {
-        seL4_SetMR(0, i);
-        seL4_SetMR(1, 0);
+#ifdef CLIENT_DYNAMIC
+    /* every INIT has been answered already */
+    return;
+#endif
 
-        reply = seL4_MessageInfo_new(INIT, 0, 0, 2);
-        seL4_Send(reply_eps[i], reply);
+    for (i = 1;i < client_num;i ++) {
+        reply = client_init_reply(i);
+        seL4_Send(CLIENT_REPLY_EP(i), reply);
+        SERVER_STATS_INC(kernel_calls);
     }
 
     return;
 }
 
+/* Count an INIT for client_barrier() and return the sender's id: the
+ * order it arrived in, or its badge's under CLIENT_BADGE. */
+static int
+client_arrive(seL4_Word badge)
+{
+    int client_id = initial_client();
+
+#ifdef CLIENT_BADGE
+    client_table_attach(badge);
+    client_id = CLIENT_BADGE_ID(badge);
+#endif
+
+    return client_id;
+}
+
+/* Id of the client a request came from, MR0 unless CLIENT_BADGE. */
+static int
+message_client(seL4_Word badge)
+{
+#ifdef CLIENT_BADGE
+    return CLIENT_BADGE_ID(badge);
+#else
+    return seL4_GetMR(0);
+#endif
+}
+
+#ifdef CLIENT_DYNAMIC
+#ifndef CLIENT_BADGE
+#error "CLIENT_DYNAMIC tells clients apart by badge, it needs CLIENT_BADGE"
+#endif
+
+/*
+    Answer an INIT at once instead of at client_barrier(), so clients
+    can join a running server; client_arrive() has attached the sender.
+    MR1 still marks client 0. Returns the INIT reply.
+*/
+static seL4_MessageInfo_t
+client_attach(int client_id)
+{
+    /* the first client starts the run */
+    if (client_table_live == 1 && terminate_num == 0) {
+        kernel_track_start();
+    }
+
+    return client_init_reply(client_id);
+}
+#endif
+
+#ifdef CLIENT_BADGE
+/* Count a message against its sender, -1 if the badge is no client's or
+ * the client is not between INIT and TMNT (for INIT: already is). */
+static int
+client_request(seL4_Word badge, int label)
+{
+    client_entry_t *client = client_table_lookup(badge);
+
+    if (client == NULL) {
+        printf("dropped a message with badge %lu, not a client's\n", (unsigned long) badge);
+        return -1;
+    }
+    if (client->attached != (label != INIT)) {
+        printf("dropped a message with label %d from client %d, %s\n", label,
+               CLIENT_BADGE_ID(badge), client->attached ? "INIT twice" : "no INIT yet");
+        return -1;
+    }
+    client->requests ++;
+
+    return 0;
+}
+#endif
+
 
 
 // sel4utils_thread_t *
@@ -554,39 +1257,120 @@ void *test_t0(void *arg)
 */
 #ifdef GREEN_THREAD
 
+#ifdef THREAD_HANDOFF
+/* the list a handler woke a thread on, switched to after the reply */
+static void *handoff_list;
+#endif
+
 #ifdef CONSUMER_PRODUCER
+#ifdef CORO_HANDLERS
+/*
+    PRODUCER and CONSUMER as stackless handlers (coroutine.h): a request
+    that has to wait parks its frame and the thread goes back to
+    receiving, instead of sleeping with its stack. Handlers never
+    switch threads, so the buffer needs no lock.
+*/
+static co_queue_t producer_frames, consumer_frames;
+
+static int
+co_producer(co_frame_t *f)
+{
+    CO_BEGIN(f);
+    CO_AWAIT(f, buffer < buffer_limit);
+    buffer ++;
+    CO_END(f);
+}
+
+static int
+co_consumer(co_frame_t *f)
+{
+    CO_BEGIN(f);
+    CO_AWAIT(f, buffer > 0);
+    buffer --;
+    CO_END(f);
+}
+
+static void
+co_request(co_handler_t handler, int label, co_queue_t *q)
+{
+    co_frame_t *f = co_frame_alloc(label);
+    int error, done;
+
+    /* a client has one request outstanding, so CO_FRAMES >= clients is enough */
+    assert(f != NULL);
+
+    error = server_stats_save_caller(&f->slot);
+    if (error != seL4_NoError) {
+        printf("device_timer_save_caller_as_waiter failed to save caller.");
+    }
+
+    if (co_dispatch(handler, f, q) == CO_WAIT) {
+        wait_count ++;
+        SERVER_STATS_INC(sleeps);
+        return;
+    }
+    SERVER_STATS_INC(kernel_calls);
+
+    /* the buffer moved, let the other side go on, and so on until neither can */
+    do {
+        done = co_queue_resume(co_producer, &producer_frames);
+        done += co_queue_resume(co_consumer, &consumer_frames);
+        SERVER_STATS_ADD(wakeups, done);
+        SERVER_STATS_ADD(kernel_calls, done);
+    } while (done > 0);
+}
+#endif
+
 int
-process_message(seL4_MessageInfo_t info, seL4_MessageInfo_t **reply, seL4_Word *reply_ep, void *sync_prim)
+process_message(seL4_MessageInfo_t info, seL4_Word badge, seL4_MessageInfo_t **reply, seL4_Word *reply_ep, void *sync_prim)
 {
     int label = seL4_MessageInfo_get_label(info);
     seL4_MessageInfo_t temp;
     int client_id, error;
     int if_defer = 1;
+#ifdef BATCH_OPS
+    int count, done, i;
+#endif
+
+#ifdef CLIENT_BADGE
+    if (client_request(badge, label) != 0) {
+        return -1;
+    }
+#endif
+
+    server_stats_label(label);
 
     switch(label) {
         case INIT:
 
-        client_id = initial_client();
+        client_id = client_arrive(badge);
+
+#ifdef CLIENT_DYNAMIC
+        /* no reply cap to keep, answer it like any other request */
+        temp = client_attach(client_id);
+        *reply = &temp;
+        return 0;
+#endif
 
         error = allocman_cspace_alloc(allocman, &pool->t_running->t->slot);
         assert(error == 0);
 
         /* check if OK to multi-cast */
-        error = vka_cnode_saveCaller(&pool->t_running->t->slot);
+        error = server_stats_save_caller(&pool->t_running->t->slot);
         if (error != seL4_NoError) {
             printf("device_timer_save_caller_as_waiter failed to save caller.");
         }
 
-        reply_eps[client_id] = (seL4_Word) pool->t_running->t->slot.offset;
+        CLIENT_REPLY_EP(client_id) = (seL4_Word) pool->t_running->t->slot.offset;
 
         if (client_barrier()) {
             seL4_MessageInfo_t reply;
 
-            seL4_SetMR(0, 0);
-            seL4_SetMR(1, 1);
+            kernel_track_start();
 
-            reply = seL4_MessageInfo_new(INIT, 0, 0, 2);
-            seL4_Send(reply_eps[0], reply);
+            reply = client_init_reply(0);
+            seL4_Send(CLIENT_REPLY_EP(0), reply);
+            SERVER_STATS_INC(kernel_calls);
 
             process_message_multicast();
         }
@@ -595,11 +1379,19 @@ process_message(seL4_MessageInfo_t info, seL4_MessageInfo_t **reply, seL4_Word *
         break;
 
         case PRODUCER:
+            kernel_track_op();
 #ifdef BENCHMARK_ENTIRE
 if (! started) {
     rdtsc_start();
     started = 1;
 }
+#endif
+#ifdef CORO_HANDLERS
+            co_request(co_producer, PRODUCER, &producer_frames);
+            return -1;
+#endif
+#ifdef BATCH_OPS
+            count = batch_count(info);
 #endif
             /* save reply ep */
             // printf("RECV a producer: %d %d thread %d\n", seL4_GetMR(0), seL4_GetMR(1), pool->t_running->t->t_id);
@@ -607,7 +1399,7 @@ if (! started) {
 #ifdef BENCHMARK_BREAKDOWN_BEFORE
 rdtsc_start();
 #endif
-            error = vka_cnode_saveCaller(&pool->t_running->t->slot);
+            error = server_stats_save_caller(&pool->t_running->t->slot);
             if (error != seL4_NoError) {
                 printf("device_timer_save_caller_as_waiter failed to save caller.");
             }
@@ -615,42 +1407,81 @@ rdtsc_start();
 rdtsc_end();
 printf("COLLECTION - before %llu %llu %llu\n", (end - start), start, end);
 #endif
+            thread_trace(TRACE_LOCK_WAIT, lock_global);
             thread_lock_acquire(lock_global);
+            thread_trace(TRACE_LOCK_ACQUIRED, lock_global);
 
             while (buffer == buffer_limit) {
                 thread_lock_release(lock_global);
+                thread_trace(TRACE_LOCK_RELEASE, lock_global);
 
+                thread_trace(TRACE_SLEEP, producer_list);
                 thread_sleep(producer_list, NULL);
+                thread_trace(TRACE_SWITCH_IN, producer_list);
                 wait_count ++;
+                SERVER_STATS_INC(sleeps);
+                thread_trace(TRACE_LOCK_WAIT, lock_global);
                 thread_lock_acquire(lock_global);
+                thread_trace(TRACE_LOCK_ACQUIRED, lock_global);
             }
 
             assert(buffer < buffer_limit);
 
+#ifdef BATCH_OPS
+            done = MIN(count, buffer_limit - buffer);
+            buffer += done;
+#else
             buffer ++;
+#endif
             // printf("get one from producer!\n");
             // printf("buffer now: %d\n", buffer);
 
+#ifdef BATCH_OPS
+            /* each item moved may let one more consumer go */
+            for (i = 1;i < done;i ++) {
+                thread_wakeup(consumer_list, NULL);
+            }
+            SERVER_STATS_ADD(wakeups, done - 1);
+#endif
+            thread_trace(TRACE_WAKEUP, consumer_list);
+#ifdef THREAD_HANDOFF
+            handoff_list = consumer_list;
+#else
             thread_wakeup(consumer_list, NULL);
+#endif
+            SERVER_STATS_INC(wakeups);
 
             thread_lock_release(lock_global);
+            thread_trace(TRACE_LOCK_RELEASE, lock_global);
 
 #ifdef BENCHMARK_BREAKDOWN_IPC
 rdtsc_start();
 #endif
 
+#ifdef BATCH_OPS
+            temp = batch_reply(PRODUCER, done);
+#else
             temp = seL4_MessageInfo_new(PRODUCER, 0, 0, 1);
+#endif
             *reply = &temp;
 
             return if_defer;
         break;
 
         case CONSUMER:
+            kernel_track_op();
 #ifdef BENCHMARK_ENTIRE
 if (! started) {
     rdtsc_start();
     started = 1;
 }
+#endif
+#ifdef CORO_HANDLERS
+            co_request(co_consumer, CONSUMER, &consumer_frames);
+            return -1;
+#endif
+#ifdef BATCH_OPS
+            count = batch_count(info);
 #endif
             // printf("RECV a consumer: %d %d thread %d\n", seL4_GetMR(0), seL4_GetMR(1), pool->t_running->t->t_id);
 
@@ -658,38 +1489,69 @@ if (! started) {
 #ifdef BENCHMARK_BREAKDOWN_BEFORE
 rdtsc_start();
 #endif
-            error = vka_cnode_saveCaller(&pool->t_running->t->slot);
+            error = server_stats_save_caller(&pool->t_running->t->slot);
             if (error != seL4_NoError) {
                 printf("device_timer_save_caller_as_waiter failed to save caller.");
             }
 #ifdef BENCHMARK_BREAKDOWN_BEFORE
 rdtsc_end();
 #endif
+            thread_trace(TRACE_LOCK_WAIT, lock_global);
             thread_lock_acquire(lock_global);
+            thread_trace(TRACE_LOCK_ACQUIRED, lock_global);
 
             while (buffer == 0) {
 
                 thread_lock_release(lock_global);
+                thread_trace(TRACE_LOCK_RELEASE, lock_global);
+                thread_trace(TRACE_SLEEP, consumer_list);
                 thread_sleep(consumer_list, NULL);
+                thread_trace(TRACE_SWITCH_IN, consumer_list);
                 wait_count ++;
+                SERVER_STATS_INC(sleeps);
+                thread_trace(TRACE_LOCK_WAIT, lock_global);
                 thread_lock_acquire(lock_global);
+                thread_trace(TRACE_LOCK_ACQUIRED, lock_global);
             }
 
             assert(buffer > 0);
+#ifdef BATCH_OPS
+            done = MIN(count, buffer);
+            buffer -= done;
+#else
             buffer --;
+#endif
 
             // printf("take one by consumer!\n");
             // printf("buffer now: %d\n", buffer);
 
+#ifdef BATCH_OPS
+            /* each item moved may let one more producer go */
+            for (i = 1;i < done;i ++) {
+                thread_wakeup(producer_list, NULL);
+            }
+            SERVER_STATS_ADD(wakeups, done - 1);
+#endif
+            thread_trace(TRACE_WAKEUP, producer_list);
+#ifdef THREAD_HANDOFF
+            handoff_list = producer_list;
+#else
             thread_wakeup(producer_list, NULL);
+#endif
+            SERVER_STATS_INC(wakeups);
 
             thread_lock_release(lock_global);
+            thread_trace(TRACE_LOCK_RELEASE, lock_global);
 
 #ifdef BENCHMARK_BREAKDOWN_IPC
 rdtsc_start();
 #endif
 
+#ifdef BATCH_OPS
+            temp = batch_reply(CONSUMER, done);
+#else
             temp = seL4_MessageInfo_new(CONSUMER, 0, 0, 1);
+#endif
             *reply = &temp;
 
             return if_defer;
@@ -697,20 +1559,34 @@ rdtsc_start();
 
         case TMNT:
 
-        client_id = seL4_GetMR(0);
+        client_id = message_client(badge);
+#ifdef CLIENT_DYNAMIC
+        client_table_detach(badge);
+#endif
+        latency_hist_from_msg(&latency_total, info);
         terminate_num ++;
 
 #ifdef BENCHMARK_ENTIRE
 if (terminate_num == client_num) {
     rdtsc_end();
     printf("COLLECTION - total time: %llu start: %llu end: %llu %d\n", (end - start), start, end, wait_count);
-    thread_exit();
+    workload_report(end - start);
 }
 #endif
 
+        /* after the total, so the printing is not part of the run */
+        if (terminate_num == client_num) {
+            green_report();
+#ifdef BENCHMARK_ENTIRE
+            thread_trace(TRACE_EXIT, NULL);
+            thread_exit();
+#endif
+        }
+
             temp = seL4_MessageInfo_new(TMNT, 0, 0, 1);
             *reply = &temp;
 
+            thread_trace(TRACE_EXIT, NULL);
             thread_exit();
             return 1;
         break;
@@ -726,39 +1602,54 @@ if (terminate_num == client_num) {
 
 #else
 int
-process_message(seL4_MessageInfo_t info, seL4_MessageInfo_t **reply, seL4_Word *reply_ep, void *sync_prim)
+process_message(seL4_MessageInfo_t info, seL4_Word badge, seL4_MessageInfo_t **reply, seL4_Word *reply_ep, void *sync_prim)
 {
     int label = seL4_MessageInfo_get_label(info);
     seL4_MessageInfo_t temp;
     int client_id, error;
     // cspacepath_t slot;
 
+#ifdef CLIENT_BADGE
+    if (client_request(badge, label) != 0) {
+        return -1;
+    }
+#endif
+
+    server_stats_label(label);
+
 
     switch(label) {
         case INIT:
         // thread_exit();
 
-        client_id = initial_client();
+        client_id = client_arrive(badge);
+
+#ifdef CLIENT_DYNAMIC
+        /* no reply cap to keep, answer it like any other request */
+        temp = client_attach(client_id);
+        *reply = &temp;
+        return 0;
+#endif
 
         error = allocman_cspace_alloc(allocman, &pool->t_running->t->slot);
         assert(error == 0);
 
         /* check if OK to multi-cast */
-        error = vka_cnode_saveCaller(&pool->t_running->t->slot);
+        error = server_stats_save_caller(&pool->t_running->t->slot);
         if (error != seL4_NoError) {
             printf("device_timer_save_caller_as_waiter failed to save caller.");
         }
 
-        reply_eps[client_id] = (seL4_Word) pool->t_running->t->slot.offset;
+        CLIENT_REPLY_EP(client_id) = (seL4_Word) pool->t_running->t->slot.offset;
 
         if (client_barrier()) {
             seL4_MessageInfo_t reply;
 
-            seL4_SetMR(0, 0);
-            seL4_SetMR(1, 1);
+            kernel_track_start();
 
-            reply = seL4_MessageInfo_new(INIT, 0, 0, 2);
-            seL4_Send(reply_eps[0], reply);
+            reply = client_init_reply(0);
+            seL4_Send(CLIENT_REPLY_EP(0), reply);
+            SERVER_STATS_INC(kernel_calls);
         }
 
         return -1;
@@ -766,13 +1657,13 @@ process_message(seL4_MessageInfo_t info, seL4_MessageInfo_t **reply, seL4_Word *
 
         case WAIT:
 
-        client_id = seL4_GetMR(0);
+        client_id = message_client(badge);
 
         // printf("Receive wait from client %d 1\n", client_id);
 
         process_message_multicast();
 
-        error = vka_cnode_saveCaller(&pool->t_running->t->slot);
+        error = server_stats_save_caller(&pool->t_running->t->slot);
         if (error != seL4_NoError) {
             printf("device_timer_save_caller_as_waiter failed to save caller.");
         }
@@ -786,7 +1677,9 @@ start_total = rdtsc();
 
         /* acquire token */
 #ifdef THREAD_LOCK
+thread_trace(TRACE_LOCK_WAIT, sync_prim);
 thread_lock_acquire(sync_prim);
+thread_trace(TRACE_LOCK_ACQUIRED, sync_prim);
 #endif
 
 #ifdef THREAD_SEMAPHORE
@@ -810,8 +1703,9 @@ start = rdtsc();
         break;
 
         case SEND_WAIT:
+        kernel_track_op();
 
-        client_id = seL4_GetMR(0);
+        client_id = message_client(badge);
         // seq = seL4_GetMR(1);
 
         /* get root cnode */
@@ -825,7 +1719,7 @@ asm volatile("CPUID\n\t"
 :: "%rax", "%rbx", "%rcx", "rdx");
 #endif
 
-        error = vka_cnode_saveCaller(&pool->t_running->t->slot);
+        error = server_stats_save_caller(&pool->t_running->t->slot);
         if (error != seL4_NoError) {
             printf("device_timer_save_caller_as_waiter failed to save caller.");
         }
@@ -858,7 +1752,9 @@ asm volatile("CPUID\n\t"
 #endif
         // thread_lock_release(sync_prim);
         // thread_lock_acquire(sync_prim);
+        thread_trace(TRACE_LOCK_WAIT, sync_prim);
         thread_lock_release_acquire(sync_prim);
+        thread_trace(TRACE_LOCK_ACQUIRED, sync_prim);
 
 #ifdef BENCHMARK_BREAKDOWN_MID
 asm volatile("RDTSCP\n\t"
@@ -910,14 +1806,26 @@ start = rdtsc();
 
         case TMNT:
 
-        client_id = seL4_GetMR(0);
+        client_id = message_client(badge);
+#ifdef CLIENT_DYNAMIC
+        client_table_detach(badge);
+#endif
+        latency_hist_from_msg(&latency_total, info);
         terminate_num ++;
+
 #ifdef BENCHMARK_ENTIRE
 if (terminate_num == client_count) {
     rdtsc_end();
     printf("COLLECTION - total time: %llu start: %llu end: %llu\n", (end_total - start_total), start_total, end_total);
+    workload_report(end_total - start_total);
 }
 #endif
+
+        /* after the total, so the printing is not part of the run */
+        if (terminate_num == client_count) {
+            green_report();
+        }
+        thread_trace(TRACE_EXIT, NULL);
         thread_exit();
         break;
 
@@ -940,7 +1848,12 @@ server_loop(void *sync_prim)
 {
     // thread_pool_info();
 
-    seL4_MessageInfo_t info = seL4_Recv(env.endpoint.cptr, NULL);
+    thread_trace(TRACE_SWITCH_IN, NULL);
+
+    /* the sender's badge, each server thread has its own */
+    seL4_Word badge;
+    seL4_MessageInfo_t info = seL4_Recv(env.endpoint.cptr, &badge);
+    SERVER_STATS_INC(kernel_calls);
 
     seL4_MessageInfo_t *reply = NULL;
     seL4_Word reply_ep;
@@ -948,21 +1861,39 @@ server_loop(void *sync_prim)
 
     while (1) {
 
+#ifdef THREAD_MSG
+        /* the request survives any switch until the next receive */
+        thread_msg_hold(info);
+#endif
         /* if_reply */
-        res = process_message(info, &reply, &reply_ep, sync_prim);
+        res = process_message(info, badge, &reply, &reply_ep, sync_prim);
         if (res == 1) {
             seL4_Send(pool->t_running->t->slot.offset, *reply);
             #ifdef BENCHMARK_BREAKDOWN_IPC
             rdtsc_end();
             printf("COLLECTION - ipc: %llu %llu %llu\n", (end - start), start, end);
             #endif
-            info = seL4_Recv(env.endpoint.cptr, NULL);
+            SERVER_STATS_INC(kernel_calls);
+#ifdef THREAD_HANDOFF
+            /* run the woken thread now rather than when someone sleeps,
+             * this thread receives the next request once it is back */
+            if (handoff_list != NULL) {
+                void *list = handoff_list;
+
+                handoff_list = NULL;
+                thread_wakeup_and_switch(list);
+            }
+#endif
+            info = seL4_Recv(env.endpoint.cptr, &badge);
+            SERVER_STATS_INC(kernel_calls);
         } else if (res == 0) {
 
             assert(reply != NULL);
-            info = seL4_ReplyRecv(env.endpoint.cptr, *reply, NULL);
+            info = seL4_ReplyRecv(env.endpoint.cptr, *reply, &badge);
+            SERVER_STATS_INC(kernel_calls);
         } else {
-            info = seL4_Recv(env.endpoint.cptr, NULL);
+            info = seL4_Recv(env.endpoint.cptr, &badge);
+            SERVER_STATS_INC(kernel_calls);
         }
     }
 
@@ -977,15 +1908,39 @@ server_loop(void *sync_prim)
 #ifdef CONSUMER_PRODUCER
 
 seL4_Word
-process_message(seL4_MessageInfo_t info, cspacepath_t *slot, seL4_MessageInfo_t **reply, void *sync_prim, void *lock)
+process_message(seL4_MessageInfo_t info, seL4_Word badge, cspacepath_t *slot, seL4_MessageInfo_t **reply, void *sync_prim, void *lock)
 {
     int label = seL4_MessageInfo_get_label(info);
     seL4_MessageInfo_t temp;
     int client_id, error;
+#ifdef BATCH_OPS
+    int count, done, i;
+#endif
+
+#ifdef CLIENT_BADGE
+    if (client_request(badge, label) != 0) {
+        return 0;
+    }
+#endif
+
+    server_stats_label(label);
 
     switch(label) {
         case INIT:
-            client_id = initial_client();
+            client_id = client_arrive(badge);
+
+#ifdef CLIENT_DYNAMIC
+            /* no reply cap to keep, answer it like any other request */
+#ifdef SEL4_GREEN
+            error = server_stats_save_caller(slot);
+            if (error != seL4_NoError) {
+                printf("device_timer_save_caller_as_waiter failed to save caller.");
+            }
+#endif
+            temp = client_attach(client_id);
+            *reply = &temp;
+            return 1;
+#endif
 
             cspacepath_t slot_temp;
 
@@ -993,21 +1948,21 @@ process_message(seL4_MessageInfo_t info, cspacepath_t *slot, seL4_MessageInfo_t
             assert(error == 0);
 
             /* check if OK to multi-cast */
-            error = vka_cnode_saveCaller(&slot_temp);
+            error = server_stats_save_caller(&slot_temp);
             if (error != seL4_NoError) {
                 printf("device_timer_save_caller_as_waiter failed to save caller.");
             }
 
-            reply_eps[client_id] = (seL4_Word) slot_temp.offset;
+            CLIENT_REPLY_EP(client_id) = (seL4_Word) slot_temp.offset;
 
             if (client_barrier()) {
                 seL4_MessageInfo_t reply;
 
-                seL4_SetMR(0, 0);
-                seL4_SetMR(1, 1);
+                kernel_track_start();
 
-                reply = seL4_MessageInfo_new(INIT, 0, 0, 2);
-                seL4_Send(reply_eps[0], reply);
+                reply = client_init_reply(0);
+                seL4_Send(CLIENT_REPLY_EP(0), reply);
+                SERVER_STATS_INC(kernel_calls);
                 process_message_multicast();
             }
 
@@ -1016,6 +1971,7 @@ process_message(seL4_MessageInfo_t info, cspacepath_t *slot, seL4_MessageInfo_t
             break;
 
             case PRODUCER:
+            kernel_track_op();
 #ifdef BENCHMARK_ENTIRE
 if (! started) {
     printf("First producer\n");
@@ -1024,6 +1980,9 @@ if (! started) {
 }
 #endif
             // printf("RECV a producer: %d %d\n", seL4_GetMR(0), seL4_GetMR(1));
+#ifdef BATCH_OPS
+            count = batch_count(info);
+#endif
 
 #ifdef SEL4_GREEN
 #ifdef BENCHMARK_BREAKDOWN_BEFORE
@@ -1037,7 +1996,7 @@ asm volatile("CPUID\n\t"
             :: "%rax", "%rbx", "%rcx", "rdx");
 #endif
 
-            error = vka_cnode_saveCaller(slot);
+            error = server_stats_save_caller(slot);
             if (error != seL4_NoError) {
                 printf("device_timer_save_caller_as_waiter failed to save caller.");
             }
@@ -1062,17 +2021,34 @@ before[before_cur ++] = sc_end - sc_start;
             while (buffer == buffer_limit) {
                 sync_mutex_unlock(&lock_global);
                 seL4_Wait(producer_list, NULL);
+                SERVER_STATS_INC(kernel_calls);
                 wait_count ++;
+                SERVER_STATS_INC(sleeps);
                 sync_mutex_lock(&lock_global);
             }
 
             assert(buffer < buffer_limit);
 
+#ifdef BATCH_OPS
+            done = MIN(count, buffer_limit - buffer);
+            buffer += done;
+#else
             buffer ++;
+#endif
             // printf("get one from producer!\n");
             // printf("buffer now: %d\n", buffer);
 
+#ifdef BATCH_OPS
+            /* each item moved may let one more consumer go */
+            for (i = 1;i < done;i ++) {
+                seL4_Signal(consumer_list);
+            }
+            SERVER_STATS_ADD(wakeups, done - 1);
+            SERVER_STATS_ADD(kernel_calls, done - 1);
+#endif
             seL4_Signal(consumer_list);
+            SERVER_STATS_INC(wakeups);
+            SERVER_STATS_INC(kernel_calls);
 
             sync_mutex_unlock(&lock_global);
 
@@ -1080,13 +2056,18 @@ before[before_cur ++] = sc_end - sc_start;
 rdtsc_start();
 #endif
 
+#ifdef BATCH_OPS
+            temp = batch_reply(PRODUCER, done);
+#else
             temp = seL4_MessageInfo_new(PRODUCER, 0, 0, 1);
+#endif
             *reply = &temp;
 
             return 1;
         break;
 
         case CONSUMER:
+            kernel_track_op();
 #ifdef BENCHMARK_ENTIRE
 if (! started) {
     printf("first consumer!\n");
@@ -1094,6 +2075,9 @@ if (! started) {
     started = 1;
 }
 #endif
+#ifdef BATCH_OPS
+            count = batch_count(info);
+#endif
 
 #ifdef SEL4_GREEN
 #ifdef BENCHMARK_BREAKDOWN_BEFORE
@@ -1107,7 +2091,7 @@ asm volatile("CPUID\n\t"
             :: "%rax", "%rbx", "%rcx", "rdx");
 #endif
 
-            error = vka_cnode_saveCaller(slot);
+            error = server_stats_save_caller(slot);
             if (error != seL4_NoError) {
                 printf("device_timer_save_caller_as_waiter failed to save caller.");
             }
@@ -1132,18 +2116,35 @@ before[before_cur ++] = sc_end1 - sc_start1;
                 sync_mutex_unlock(&lock_global);
 
                 seL4_Wait(consumer_list, NULL);
+                SERVER_STATS_INC(kernel_calls);
                 wait_count ++;
+                SERVER_STATS_INC(sleeps);
                 sync_mutex_lock(&lock_global);
             }
 
             assert(buffer > 0);
+#ifdef BATCH_OPS
+            done = MIN(count, buffer);
+            buffer -= done;
+#else
             buffer --;
+#endif
 
             // printf("take one by consumer!\n");
             // printf("buffer now: %d\n", buffer);
 
 
+#ifdef BATCH_OPS
+            /* each item moved may let one more producer go */
+            for (i = 1;i < done;i ++) {
+                seL4_Signal(producer_list);
+            }
+            SERVER_STATS_ADD(wakeups, done - 1);
+            SERVER_STATS_ADD(kernel_calls, done - 1);
+#endif
             seL4_Signal(producer_list);
+            SERVER_STATS_INC(wakeups);
+            SERVER_STATS_INC(kernel_calls);
 
             sync_mutex_unlock(&lock_global);
 
@@ -1151,7 +2152,11 @@ before[before_cur ++] = sc_end1 - sc_start1;
 rdtsc_start();
 #endif
 
+#ifdef BATCH_OPS
+            temp = batch_reply(CONSUMER, done);
+#else
             temp = seL4_MessageInfo_new(CONSUMER, 0, 0, 1);
+#endif
             *reply = &temp;
 
             return 1;
@@ -1160,7 +2165,11 @@ rdtsc_start();
 
         case TMNT:
 
-        client_id = seL4_GetMR(0);
+        client_id = message_client(badge);
+#ifdef CLIENT_DYNAMIC
+        client_table_detach(badge);
+#endif
+        latency_hist_from_msg(&latency_total, info);
         // printf("Client %d terminates\n", client_id);
 
         terminate_num ++;
@@ -1169,7 +2178,11 @@ rdtsc_start();
 #ifdef BENCHMARK_ENTIRE
             rdtsc_end();
             printf("COLLECTION - total time %llu %llu %llu %d\n", (end - start), start, end, wait_count);
+            workload_report(end - start);
 #endif
+            /* after the total, so the printing is not part of the run */
+            kernel_track_dump();
+            latency_hist_print(&latency_total);
             // printf("end of test\n");
         }
 
@@ -1187,36 +2200,67 @@ rdtsc_start();
 #else
 
 seL4_Word
-process_message(seL4_MessageInfo_t info, seL4_MessageInfo_t **reply, void *sync_prim, void *lock)
+process_message(seL4_MessageInfo_t info, seL4_Word badge, seL4_MessageInfo_t **reply, void *sync_prim, void *lock)
 {
     int label = seL4_MessageInfo_get_label(info);
     seL4_MessageInfo_t temp;
     int client_id, error;
     cspacepath_t slot;
 
+#ifdef CLIENT_BADGE
+    if (client_request(badge, label) != 0) {
+        return 0;
+    }
+#endif
+
+    server_stats_label(label);
+
     switch(label) {
         case INIT:
-        client_id = initial_client();
+        client_id = client_arrive(badge);
+
+#ifdef CLIENT_DYNAMIC
+        /* no reply cap to keep, answer it like any other request */
+        temp = client_attach(client_id);
+#ifdef SEL4_GREEN
+        /* the slot is only needed for this one reply */
+        error = allocman_cspace_alloc(allocman, &slot);
+        assert(error == 0);
+
+        error = server_stats_save_caller(&slot);
+        if (error != seL4_NoError) {
+            printf("device_timer_save_caller_as_waiter failed to save caller.");
+        }
+
+        seL4_Send(slot.offset, temp);
+        SERVER_STATS_INC(kernel_calls);
+        allocman_cspace_free(allocman, &slot);
+        return 0;
+#else
+        *reply = &temp;
+        return 1;
+#endif
+#endif
 
         /* check if OK to multi-cast */
         error = allocman_cspace_alloc(allocman, &slot);
         assert(error == 0);
 
-        error = vka_cnode_saveCaller(&slot);
+        error = server_stats_save_caller(&slot);
         if (error != seL4_NoError) {
             printf("device_timer_save_caller_as_waiter failed to save caller.");
         }
 
-        reply_eps[client_id] = (seL4_Word) slot.offset;
+        CLIENT_REPLY_EP(client_id) = (seL4_Word) slot.offset;
 
         if (client_barrier()) {
             seL4_MessageInfo_t reply;
 
-            seL4_SetMR(0, 0);
-            seL4_SetMR(1, 1);
+            kernel_track_start();
 
-            reply = seL4_MessageInfo_new(INIT, 0, 0, 2);
-            seL4_Send(reply_eps[0], reply);
+            reply = client_init_reply(0);
+            seL4_Send(CLIENT_REPLY_EP(0), reply);
+            SERVER_STATS_INC(kernel_calls);
         }
 
         return 0;
@@ -1224,7 +2268,7 @@ process_message(seL4_MessageInfo_t info, seL4_MessageInfo_t **reply, void *sync_
 
         case WAIT:
 
-        client_id = seL4_GetMR(0);
+        client_id = message_client(badge);
 
 #ifdef SEL4_GREEN
         process_message_multicast();
@@ -1232,7 +2276,7 @@ process_message(seL4_MessageInfo_t info, seL4_MessageInfo_t **reply, void *sync_
         error = allocman_cspace_alloc(allocman, &slot);
         assert(error == 0);
 
-        error = vka_cnode_saveCaller(&slot);
+        error = server_stats_save_caller(&slot);
         if (error != seL4_NoError) {
             printf("device_timer_save_caller_as_waiter failed to save caller.");
         }
@@ -1278,8 +2322,9 @@ rdtsc_end();
 
         case SEND_WAIT:
         // exit(0);
+        kernel_track_op();
 
-        client_id = seL4_GetMR(0);
+        client_id = message_client(badge);
         // seq = seL4_GetMR(1);
 
 #ifdef SEL4_GREEN
@@ -1289,7 +2334,7 @@ start = rdtsc();
         error = allocman_cspace_alloc(allocman, &slot);
         assert(error == 0);
 
-        error = vka_cnode_saveCaller(&slot);
+        error = server_stats_save_caller(&slot);
         if (error != seL4_NoError) {
             printf("device_timer_save_caller_as_waiter failed to save caller.");
         }
@@ -1357,7 +2402,11 @@ rdtsc_start();
 
         case TMNT:
 
-        client_id = seL4_GetMR(0);
+        client_id = message_client(badge);
+#ifdef CLIENT_DYNAMIC
+        client_table_detach(badge);
+#endif
+        latency_hist_from_msg(&latency_total, info);
         // printf("Client %d terminates\n", client_id);
 
         terminate_num ++;
@@ -1366,9 +2415,16 @@ rdtsc_start();
 if (terminate_num == client_count) {
     end_total = rdtsc();
     printf("COLLECTION - total time: %llu start: %llu end: %llu\n", (end_total - start_total), start_total, end_total);
+    workload_report(end_total - start_total);
 }
 #endif
 
+        /* after the total, so the printing is not part of the run */
+        if (terminate_num == client_count) {
+            kernel_track_dump();
+            latency_hist_print(&latency_total);
+        }
+
         break;
 
         case IMMD:
@@ -1390,9 +2446,11 @@ server_loop(void *sync_prim, void *lock)
     assert(sync_prim != NULL);
 
     seL4_MessageInfo_t *reply = NULL;
+    seL4_Word badge;
     int res;
 
-    seL4_MessageInfo_t info = seL4_Recv(env.endpoint.cptr, NULL);
+    seL4_MessageInfo_t info = seL4_Recv(env.endpoint.cptr, &badge);
+    SERVER_STATS_INC(kernel_calls);
 
     cspacepath_t slot;
     int error;
@@ -1402,38 +2460,42 @@ server_loop(void *sync_prim, void *lock)
 
 
     while (1) {
-        res = process_message(info, &slot, &reply, sync_prim, lock);
+        res = process_message(info, badge, &slot, &reply, sync_prim, lock);
 
         if (res) {
 
 #ifdef SEL4_GREEN
             seL4_Send(slot.offset, *reply);
-            info = seL4_Recv(env.endpoint.cptr, NULL);
+            info = seL4_Recv(env.endpoint.cptr, &badge);
 #ifdef BENCHMARK_BREAKDOWN_IPC
 rdtsc_end();
 ipc[ipc_cur ++] = end - start;
 #endif
+            SERVER_STATS_ADD(kernel_calls, 2);
 #endif
 
 #ifdef SEL4_SLOW
             seL4_Reply(*reply);
-            info = seL4_Recv(env.endpoint.cptr, NULL);
+            info = seL4_Recv(env.endpoint.cptr, &badge);
 #ifdef BENCHMARK_BREAKDOWN_IPC
 rdtsc_end();
 printf("COLLECTION - slowpath: %llu %llu %llu\n", (end - start), start, end);
 #endif
+            SERVER_STATS_ADD(kernel_calls, 2);
 #endif
 
 #ifdef SEL4_FAST
-            info = seL4_ReplyRecv(env.endpoint.cptr, *reply, NULL);
+            info = seL4_ReplyRecv(env.endpoint.cptr, *reply, &badge);
 #ifdef BENCHMARK_BREAKDOWN_IPC
 rdtsc_end();
 // printf("COLLECTION - fastpath: %llu\n", (end - start));
 ipc[ipc_cur ++] = end - start;
 #endif
+            SERVER_STATS_INC(kernel_calls);
 #endif
         } else {
-            info = seL4_Recv(env.endpoint.cptr, NULL);
+            info = seL4_Recv(env.endpoint.cptr, &badge);
+            SERVER_STATS_INC(kernel_calls);
         }
 
     }
@@ -1551,8 +2613,10 @@ thread_creation(void *sync_prim, int num)
     assert(num > 0);
     int i, res = 0;
 
-    for (i = 0;i < num;i ++)
+    for (i = 0;i < num;i ++) {
         res = thread_create(allocman, &env.vspace, server_loop, sync_prim);
+        thread_trace_id(TRACE_CREATE, res, NULL);
+    }
 
     return res;
 }
@@ -1574,6 +2638,9 @@ void *main_continued(void *arg UNUSED)
 
     /* allocate lots of untyped memory for tests to use */
     num_untypeds = populate_untypeds(untypeds);
+#ifdef SHARED_UNTYPED_CNODE
+    init_untyped_cnode();
+#endif
 
     /* create a frame that will act as the init data, we can then map that
      * in to target processes */
@@ -1591,6 +2658,9 @@ void *main_continued(void *arg UNUSED)
     error = vka_cnode_copy(&dest, &src, seL4_AllRights);
     assert(error == 0);
 
+    /* hand the kernel a buffer to log kernel entries into */
+    kernel_track_init(&env);
+
     /* copy the untyped size bits list across to the init frame */
     memcpy(env.init->untyped_size_bits_list, untyped_size_bits_list, sizeof(uint8_t) * num_untypeds);
 
@@ -1607,16 +2677,52 @@ void *main_continued(void *arg UNUSED)
     env.init->priority = seL4_MaxPrio;
     plat_init(&env);
 
+    /* server counters are shared with every client spawned below */
+    init_server_stats();
+    init_workload();
+
+#ifdef CLIENT_TEMPLATE
+    /* load the client image once, clients are cloned from it */
+    error = client_template_init(&env.vka, &env.vspace, simple_get_cnode(&env.simple), TESTS_APP,
+                                 seL4_MaxPrio);
+    ZF_LOGF_IF(error, "Failed to set up the client template");
+#endif
+
     /* now run the tests */
     //sel4test_run_tests("sel4test", run_test);
-    sel4test_run_tests_new("sel4test", run_test_new);
+    run_clients(workload->clients - workload->local);
 
+    /* the rest of the clients run as threads of the driver, below the
+     * server (seL4_MaxPrio) so that a waiting client never delays it */
+    local_clients_start(&env.vka, &env.vspace, simple_get_cnode(&env.simple), env.endpoint.cptr,
+                        workload->local, LOCAL_CLIENT_PRIORITY);
 
-    client_count = 6;
+
+    client_count = workload->clients;
 printf("start\n");
 #ifdef GREEN_THREAD
     thread_initial();
+
+#ifdef THREAD_STATS
+    thread_stats_page = vspace_new_pages(&env.vspace, seL4_AllRights, 1, PAGE_BITS_4K);
+    assert(thread_stats_page != NULL);
+#endif
+
+#ifdef THREAD_BENCH
+    thread_bench_run(allocman, &env.vspace);
+#endif
+#ifdef EXECUTOR
+    error = executor_init(allocman, &env.vspace, EXECUTOR_WORKERS);
+    assert(error == 0);
+#endif
+#ifdef CORO_HANDLERS
+    error = co_frames_init(allocman, CO_FRAMES);
+    assert(error == 0);
+#endif
     initial_client_pool(client_count);
+#ifdef BATCH_OPS
+    buffer_limit = BATCH_BUFFER;
+#endif
 
 
 
@@ -1657,6 +2763,9 @@ printf("start\n");
 
     /* initial clients pool */
     initial_client_pool(client_count);
+#ifdef BATCH_OPS
+    buffer_limit = BATCH_BUFFER;
+#endif
 
     sel4_threads_initial(client_count);
 
@@ -1776,45 +2885,6 @@ int main(void)
     // printf("end\n");
     /* test thread library end */
 
-    /* Get execution time for kernel context-switching */
-    // uint64_t save_start, save_end, restore_start, restore_end;
-    // uint32_t save_elapsed, restore_elapsed;
-    //
-    // for (int i = 0;i < 1050;i ++) {
-    //
-    // save_start = rdtsc();
-    // seL4_SetMR(0, 0xDEADBEEF);
-    // seL4_DebugHalt();
-    // save_end = seL4_GetMR(5);
-    // save_end <<= 32;
-    // save_end |= seL4_GetMR(6);
-    //
-    // save_elapsed = save_end - save_start;
-    //
-    // restore_start = seL4_GetMR(3);
-    // restore_start <<= 32;
-    // restore_start |= seL4_GetMR(4);
-    // restore_end = rdtsc();
-    //
-    // restore_elapsed = restore_end - restore_start;
-    //
-    // printf("%d\n", i);
-    //
-    // printf("COLLECTION - Got RDTSC values: save %u, restore %u.\n"
-    //         "COLLECTION - \tSave: start %u_%u, end %u_%u.\n"
-    //         "COLLECTION - \tEnd: start %u_%u, end %u_%u.\n",
-    //         save_elapsed, restore_elapsed,
-    //         (uint32_t)((save_start >> 32) & UINT32_MAX),
-    //         (uint32_t)((save_start) & UINT32_MAX),
-    //         (uint32_t)((save_end >> 32) & UINT32_MAX),
-    //         (uint32_t)((save_end) & UINT32_MAX),
-    //         (uint32_t)((restore_start >> 32) & UINT32_MAX),
-    //         (uint32_t)((restore_start) & UINT32_MAX),
-    //         (uint32_t)((restore_end >> 32) & UINT32_MAX),
-    //         (uint32_t)((restore_end) & UINT32_MAX));
-    // }
-
-
     void *res;
     error = sel4utils_run_on_stack(&env.vspace, main_continued, NULL, &res);
     test_assert_fatal(error == 0);
@@ -0,0 +1,76 @@
+/*
+    Always-on counters of the server loop.
+
+    The counters live in their own frame. The driver maps that frame
+    read-only into every client it spawns and passes the address as the
+    third argument, so a monitor client can read it without a special
+    build. Counters are plain increments: cheap, but not atomic across
+    seL4 server threads.
+*/
+#ifndef SERVER_STATS_H
+#define SERVER_STATS_H
+
+#include <stdint.h>
+
+#include <sel4/sel4.h>
+#include <vka/capops.h>
+
+#include "lib_test.h"
+
+#define SERVER_STATS_MAGIC 0x53525653 /* "SVRS" */
+#define SERVER_STATS_VERSION 1
+
+typedef struct server_stats_t {
+    seL4_Word magic;
+    seL4_Word version;
+
+    /* messages received, per label */
+    seL4_Word init;
+    seL4_Word wait;
+    seL4_Word send_wait;
+    seL4_Word producer;
+    seL4_Word consumer;
+    seL4_Word tmnt;
+    seL4_Word immd;
+    seL4_Word unknown;
+
+    /* kernel calls issued by the server, including saveCaller */
+    seL4_Word kernel_calls;
+    /* reply caps saved with saveCaller */
+    seL4_Word reply_caps;
+    /* server threads put to sleep and woken on the buffer condition */
+    seL4_Word sleeps;
+    seL4_Word wakeups;
+} server_stats_t;
+
+extern server_stats_t *server_stats;
+
+#define SERVER_STATS_INC(field) (server_stats->field ++)
+#define SERVER_STATS_ADD(field, n) (server_stats->field += (n))
+
+static inline void
+server_stats_label(int label)
+{
+    switch (label) {
+        case INIT: SERVER_STATS_INC(init); break;
+        case WAIT: SERVER_STATS_INC(wait); break;
+        case SEND_WAIT: SERVER_STATS_INC(send_wait); break;
+        case PRODUCER: SERVER_STATS_INC(producer); break;
+        case CONSUMER: SERVER_STATS_INC(consumer); break;
+        case TMNT: SERVER_STATS_INC(tmnt); break;
+        case IMMD: SERVER_STATS_INC(immd); break;
+        default: SERVER_STATS_INC(unknown); break;
+    }
+}
+
+/* vka_cnode_saveCaller() that counts the saved reply cap */
+static inline int
+server_stats_save_caller(const cspacepath_t *slot)
+{
+    SERVER_STATS_INC(kernel_calls);
+    SERVER_STATS_INC(reply_caps);
+
+    return vka_cnode_saveCaller(slot);
+}
+
+#endif
@@ -0,0 +1,24 @@
+echo "Sweep start"
+
+# client counts to run, e.g. sh sweep.sh 1 2 4 8
+counts=${*:-"1 2 4 8 16 32"}
+
+rm -f sweep.log
+
+for n in $counts
+do
+	echo "Clients: $n"
+
+	# WORKLOAD_CLIENTS only reaches main.c through NK_CFLAGS, force a rebuild
+	touch -c apps/sel4test-driver/src/main.c
+	make NK_CFLAGS="-DWORKLOAD_CLIENTS=$n" || exit 1
+
+	res=`mq.sh run -c "end of test" -l output -s haswell4 -f images/kernel-ia32-pc99 -f images/sel4test-driver-image-ia32-pc99`
+
+	echo "$res" | egrep "COLLECTION" >> sweep.log
+
+done
+
+python sweep_table.py sweep.log
+
+echo "Sweep end\n"
@@ -0,0 +1,42 @@
+#!/usr/bin/env python
+"""
+Turn the COLLECTION lines of a client count sweep (sweep.sh) into a table.
+
+    python sweep_table.py sweep.log --mhz 3400
+
+Throughput comes from the driver's "throughput" line. Latency is the mean
+time a request spends in the system, from Little's law: clients / throughput
+(the clients are closed-loop, one request outstanding each).
+"""
+
+import argparse
+import sys
+
+
+def parse(lines):
+    for line in lines:
+        fields = line.split()
+        if fields[:3] != ['COLLECTION', '-', 'throughput']:
+            continue
+        values = dict(zip(fields[3::2], fields[4::2]))
+        yield int(values['clients']), int(values['requests']), int(values['cycles'])
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('log', nargs='?', type=argparse.FileType('r'), default=sys.stdin)
+    parser.add_argument('--mhz', type=float, default=3400, help='TSC frequency of the target')
+    args = parser.parse_args()
+
+    print('%8s %10s %14s %12s %14s %12s' % ('clients', 'requests', 'cycles', 'req/s', 'cycles/req', 'latency us'))
+    for clients, requests, cycles in sorted(parse(args.log)):
+        if requests == 0 or cycles == 0:
+            continue
+        per_request = cycles / float(requests)
+        throughput = requests * args.mhz * 1e6 / cycles
+        latency = clients * per_request / args.mhz
+        print('%8d %10d %14d %12.0f %14.0f %12.2f' % (clients, requests, cycles, throughput, per_request, latency))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,579 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include <utils/util.h>
+
+#include "thread_bench.h"
+#include "sync_prim.h"
+#include "thread_hooks.h"
+#include "thread_fpu.h"
+#include "thread_slab.h"
+#include "thread_executor.h"
+#include "thread_context.h"
+
+#define BENCH_MAX_THREADS 32
+#define BENCH_SWAP_STACK (4 * PAGE_SIZE_4K)
+
+static const int bench_counts[] = {2, 8, 32};
+static const int bench_create_counts[] = {1, 8, 16};
+
+static allocman_t *bench_allocman;
+static vspace_t *bench_vspace;
+
+/* operations done by all participants, the master times a window of them */
+static volatile int bench_ops;
+static volatile int bench_stop;
+static volatile int bench_alive;
+
+/* ring benchmarks: whose turn it is, and one object per participant */
+static volatile int bench_turn;
+static int bench_num;
+static void *bench_objs[BENCH_MAX_THREADS];
+static thread_lock_t *bench_lock;
+
+/* loop benchmarks: the step every participant repeats */
+static void (*bench_step)(void);
+
+typedef struct bench_result_t {
+    uint64_t samples[THREAD_BENCH_ROUNDS];
+    int num;
+} bench_result_t;
+
+static uint64_t
+bench_isqrt(uint64_t x)
+{
+    uint64_t r = 0, bit = 1ull << 62;
+
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (x >= r + bit) {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return r;
+}
+
+static void
+bench_report(const char *name, int threads, int ops, bench_result_t *res)
+{
+    uint64_t sum = 0, var = 0, min = UINT64_MAX, max = 0, mean;
+    int i;
+
+    for (i = 0;i < res->num;i ++) {
+        sum += res->samples[i];
+        if (res->samples[i] < min) {
+            min = res->samples[i];
+        }
+        if (res->samples[i] > max) {
+            max = res->samples[i];
+        }
+    }
+    mean = sum / res->num;
+
+    for (i = 0;i < res->num;i ++) {
+        int64_t d = (int64_t) (res->samples[i] - mean);
+        var += d * d;
+    }
+    var /= res->num;
+
+    printf("COLLECTION - bench %s threads %d ops %d mean %llu stddev %llu min %llu max %llu\n",
+           name, threads, ops, (unsigned long long) mean, (unsigned long long) bench_isqrt(var),
+           (unsigned long long) min, (unsigned long long) max);
+}
+
+static void
+bench_spawn(void *(*func)(void *), int num)
+{
+    int i, t_id;
+
+    for (i = 0;i < num;i ++) {
+        bench_alive ++;
+        t_id = thread_create(bench_allocman, bench_vspace, func, (void *) (uintptr_t) (i + 1));
+        assert(t_id >= 0);
+    }
+}
+
+/* let every worker run until it has exited */
+static void
+bench_reap(void)
+{
+    while (bench_alive > 0) {
+        thread_yield();
+    }
+}
+
+static void *
+bench_exit_worker(void *arg)
+{
+    bench_alive --;
+    thread_exit();
+
+    return arg;
+}
+
+/* create and exit: n creates timed, then the time for all n to run and exit */
+static void
+bench_create_exit(void)
+{
+    bench_result_t create, exits;
+    uint64_t t0, t1;
+    unsigned c;
+    int r;
+
+    for (c = 0;c < ARRAY_SIZE(bench_create_counts);c ++) {
+        int n = bench_create_counts[c];
+
+        create.num = exits.num = 0;
+        for (r = 0;r < THREAD_BENCH_ROUNDS;r ++) {
+            t0 = rdtsc();
+            bench_spawn(bench_exit_worker, n);
+            t1 = rdtsc();
+            create.samples[create.num ++] = (t1 - t0) / n;
+
+            t0 = rdtsc();
+            bench_reap();
+            t1 = rdtsc();
+            exits.samples[exits.num ++] = (t1 - t0) / n;
+        }
+
+        bench_report("create", n, n, &create);
+        bench_report("exit", n, n, &exits);
+    }
+}
+
+/* join on a thread that has not run yet: block, it runs and exits, wake up */
+static void
+bench_join(void)
+{
+    bench_result_t res;
+    uint64_t t0, t1, total;
+    int r, i, t_id;
+
+    res.num = 0;
+    for (r = 0;r < THREAD_BENCH_ROUNDS;r ++) {
+        total = 0;
+        for (i = 0;i < 8;i ++) {
+            bench_alive ++;
+            t_id = thread_create(bench_allocman, bench_vspace, bench_exit_worker, NULL);
+            assert(t_id >= 0);
+
+            t0 = rdtsc();
+            thread_join(t_id);
+            t1 = rdtsc();
+            total += t1 - t0;
+        }
+        res.samples[res.num ++] = total / 8;
+    }
+
+    bench_report("join", 2, 8, &res);
+}
+
+/* the bare thread_ctx_swap, no scheduler: ping-pong with a context of our own */
+static thread_ctx_t bench_swap_self, bench_swap_peer;
+static char bench_swap_stack[BENCH_SWAP_STACK] ALIGN(16);
+
+static void *
+bench_swap_worker(void *arg)
+{
+    while (1) {
+        thread_ctx_swap(&bench_swap_peer, &bench_swap_self);
+    }
+
+    return arg;
+}
+
+static void
+bench_swap(void)
+{
+    bench_result_t res;
+    uint64_t t0, t1;
+    int r, i;
+
+    thread_ctx_init(&bench_swap_peer, bench_swap_stack + sizeof(bench_swap_stack),
+                    bench_swap_worker, NULL);
+
+    res.num = 0;
+    for (r = 0;r < THREAD_BENCH_ROUNDS;r ++) {
+        t0 = rdtsc();
+        for (i = 0;i < THREAD_BENCH_OPS;i ++) {
+            thread_ctx_swap(&bench_swap_self, &bench_swap_peer);
+        }
+        t1 = rdtsc();
+        /* there and back */
+        res.samples[res.num ++] = (t1 - t0) / (2 * THREAD_BENCH_OPS);
+    }
+
+    bench_report("swap", 2, THREAD_BENCH_OPS, &res);
+}
+
+/* a slab cache round trip: take BENCH_MAX_THREADS objects, give them back */
+static void
+bench_slab(void)
+{
+    bench_result_t res;
+    uint64_t t0, t1;
+    int r, i, j;
+
+    res.num = 0;
+    for (r = 0;r < THREAD_BENCH_ROUNDS;r ++) {
+        t0 = rdtsc();
+        for (i = 0;i < THREAD_BENCH_OPS / BENCH_MAX_THREADS;i ++) {
+            for (j = 0;j < BENCH_MAX_THREADS;j ++) {
+                bench_objs[j] = thread_slab_alloc(&thread_slab_msgs);
+                assert(bench_objs[j] != NULL);
+            }
+            for (j = 0;j < BENCH_MAX_THREADS;j ++) {
+                thread_slab_free(&thread_slab_msgs, bench_objs[j]);
+            }
+        }
+        t1 = rdtsc();
+        /* an allocation and a free */
+        res.samples[res.num ++] = (t1 - t0) / (i * BENCH_MAX_THREADS);
+    }
+
+    bench_report("slab_alloc_free", 1, i * BENCH_MAX_THREADS, &res);
+}
+
+/* the runtime's lock, made and destroyed: from the slab cache with THREAD_SLAB, malloc without */
+static void
+bench_lock_create(void)
+{
+    bench_result_t res;
+    uint64_t t0, t1;
+    int r, i, j;
+
+    res.num = 0;
+    for (r = 0;r < THREAD_BENCH_ROUNDS;r ++) {
+        t0 = rdtsc();
+        for (i = 0;i < THREAD_BENCH_OPS / BENCH_MAX_THREADS;i ++) {
+            for (j = 0;j < BENCH_MAX_THREADS;j ++) {
+                bench_objs[j] = thread_lock_create();
+                assert(bench_objs[j] != NULL);
+            }
+            for (j = 0;j < BENCH_MAX_THREADS;j ++) {
+                thread_lock_destory(bench_objs[j]);
+            }
+        }
+        t1 = rdtsc();
+        res.samples[res.num ++] = (t1 - t0) / (i * BENCH_MAX_THREADS);
+    }
+
+    bench_report("lock_create_destory", 1, i * BENCH_MAX_THREADS, &res);
+}
+
+static void *
+bench_task(void *arg)
+{
+    return arg;
+}
+
+/* executor round trip: submit an empty task, sleep until a parked worker has run it */
+static void
+bench_executor(void)
+{
+    executor_future_t *f;
+    bench_result_t res;
+    uint64_t t0, t1;
+    UNUSED int error;
+    int r, i;
+
+    error = executor_init(bench_allocman, bench_vspace, EXECUTOR_WORKERS);
+    assert(error == 0);
+
+    res.num = 0;
+    for (r = 0;r < THREAD_BENCH_ROUNDS;r ++) {
+        t0 = rdtsc();
+        for (i = 0;i < THREAD_BENCH_OPS;i ++) {
+            f = executor_submit(bench_task, NULL);
+            future_wait(f);
+            future_release(f);
+        }
+        t1 = rdtsc();
+        res.samples[res.num ++] = (t1 - t0) / THREAD_BENCH_OPS;
+    }
+
+    bench_report("executor", EXECUTOR_WORKERS + 1, THREAD_BENCH_OPS, &res);
+}
+
+/*
+    Loop benchmarks: every participant repeats the same step until
+    bench_stop. The master (participant 0) times THREAD_BENCH_OPS steps
+    taken by anyone.
+*/
+static void *
+bench_loop_worker(void *arg)
+{
+    while (!bench_stop) {
+        bench_step();
+    }
+
+    bench_alive --;
+    thread_exit();
+
+    return arg;
+}
+
+static void
+bench_loop(const char *name, void (*step)(void))
+{
+    bench_result_t res;
+    uint64_t t0, t1;
+    unsigned c;
+    int r, ops;
+
+    for (c = 0;c < ARRAY_SIZE(bench_counts);c ++) {
+        int n = bench_counts[c];
+
+        bench_step = step;
+        bench_stop = 0;
+        bench_spawn(bench_loop_worker, n - 1);
+
+        res.num = 0;
+        for (r = 0;r < THREAD_BENCH_ROUNDS;r ++) {
+            ops = bench_ops;
+            t0 = rdtsc();
+            while (bench_ops - ops < THREAD_BENCH_OPS) {
+                step();
+            }
+            t1 = rdtsc();
+            res.samples[res.num ++] = (t1 - t0) / (bench_ops - ops);
+        }
+
+        bench_stop = 1;
+        bench_reap();
+        bench_report(name, n, THREAD_BENCH_OPS, &res);
+    }
+}
+
+static void
+bench_yield_step(void)
+{
+    bench_ops ++;
+    thread_yield();
+}
+
+/* yield as FPU threads: every switch between participants moves the FPU state */
+static void
+bench_fpu_step(void)
+{
+    thread_fpu_enter();
+    bench_ops ++;
+    thread_yield();
+}
+
+static void
+bench_lock_step(void)
+{
+    thread_lock_acquire(bench_lock);
+    bench_ops ++;
+    /* hold the lock across a switch so that the others queue on it */
+    thread_yield();
+    thread_lock_release(bench_lock);
+}
+
+/*
+    Ring benchmarks: a token goes round the participants, each handoff
+    is one operation. wait() blocks participant i until it holds the
+    token, pass() hands it to the next one.
+*/
+typedef struct bench_ring_t {
+    const char *name;
+    void (*wait)(int i);
+    void (*pass)(int next);
+    void *(*create)(void);
+    void (*destroy)(void *obj);
+} bench_ring_t;
+
+static const bench_ring_t *bench_ring_cur;
+
+static void
+bench_ring_pass(int i)
+{
+    int next = (i + 1) % bench_num;
+
+    bench_turn = next;
+    bench_ops ++;
+    bench_ring_cur->pass(next);
+}
+
+static void *
+bench_ring_worker(void *arg)
+{
+    int i = (int) (uintptr_t) arg;
+
+    while (1) {
+        bench_ring_cur->wait(i);
+        if (bench_stop) {
+            break;
+        }
+        bench_ring_pass(i);
+    }
+
+    /* pass the token on so that the others see bench_stop too */
+    bench_ring_pass(i);
+    bench_alive --;
+    thread_exit();
+
+    return arg;
+}
+
+static void
+bench_ring(const bench_ring_t *ring)
+{
+    bench_result_t res;
+    uint64_t t0, t1;
+    unsigned c;
+    int r, i, ops;
+
+    bench_ring_cur = ring;
+
+    for (c = 0;c < ARRAY_SIZE(bench_counts);c ++) {
+        int n = bench_counts[c];
+
+        assert(n <= BENCH_MAX_THREADS);
+        bench_num = n;
+        bench_turn = 0;
+        bench_stop = 0;
+        for (i = 0;i < n;i ++) {
+            bench_objs[i] = ring->create();
+            assert(bench_objs[i] != NULL);
+        }
+        bench_spawn(bench_ring_worker, n - 1);
+
+        res.num = 0;
+        for (r = 0;r < THREAD_BENCH_ROUNDS;r ++) {
+            ops = bench_ops;
+            t0 = rdtsc();
+            while (bench_ops - ops < THREAD_BENCH_OPS) {
+                bench_ring_pass(0);
+                ring->wait(0);
+            }
+            t1 = rdtsc();
+            res.samples[res.num ++] = (t1 - t0) / (bench_ops - ops);
+        }
+
+        bench_stop = 1;
+        bench_ring_pass(0);
+        ring->wait(0);
+        bench_reap();
+        for (i = 0;i < n;i ++) {
+            ring->destroy(bench_objs[i]);
+        }
+        bench_report(ring->name, n, THREAD_BENCH_OPS, &res);
+    }
+}
+
+static void
+bench_sem_wait(int i)
+{
+    thread_semaphore_P(bench_objs[i]);
+}
+
+static void
+bench_sem_pass(int next)
+{
+    thread_semaphore_V(bench_objs[next]);
+}
+
+static void
+bench_cv_wait(int i)
+{
+    thread_lock_acquire(bench_lock);
+    while (bench_turn != i) {
+        thread_cv_wait(bench_objs[i], bench_lock);
+    }
+    thread_lock_release(bench_lock);
+}
+
+static void
+bench_cv_pass(int next)
+{
+    thread_cv_signal(bench_objs[next]);
+}
+
+static void
+bench_sleep_wait(int i)
+{
+    while (bench_turn != i) {
+        thread_sleep(bench_objs[i], NULL);
+    }
+}
+
+static void
+bench_sleep_pass(int next)
+{
+    thread_wakeup(bench_objs[next], NULL);
+}
+
+static void *
+bench_new_semaphore(void)
+{
+    return thread_semaphore_create();
+}
+
+static void
+bench_free_semaphore(void *obj)
+{
+    thread_semaphore_destory(obj);
+}
+
+/* cvs and sleep lists are plain sync prims, the driver makes them as locks */
+static void *
+bench_new_list(void)
+{
+    return thread_lock_create();
+}
+
+static void
+bench_free_list(void *obj)
+{
+    thread_lock_destory(obj);
+}
+
+static const bench_ring_t bench_rings[] = {
+    {"semaphore", bench_sem_wait, bench_sem_pass, bench_new_semaphore, bench_free_semaphore},
+    {"cv", bench_cv_wait, bench_cv_pass, bench_new_list, bench_free_list},
+    {"sleep_wakeup", bench_sleep_wait, bench_sleep_pass, bench_new_list, bench_free_list},
+};
+
+void
+thread_bench_run(allocman_t *allocman, vspace_t *vspace)
+{
+    unsigned i;
+
+    assert(pool != NULL);
+
+    bench_allocman = allocman;
+    bench_vspace = vspace;
+
+    printf("bench: %d rounds, cycles per operation\n", THREAD_BENCH_ROUNDS);
+
+    bench_swap();
+    bench_slab();
+    bench_lock_create();
+    bench_create_exit();
+    bench_join();
+    bench_executor();
+
+    bench_lock = thread_lock_create();
+    assert(bench_lock != NULL);
+
+    bench_loop("yield", bench_yield_step);
+    bench_loop("fpu_yield", bench_fpu_step);
+    /* the master took part, keep its FPU state out of the rest */
+    thread_fpu_leave(pool->t_running->t_id);
+    bench_loop("lock_handoff", bench_lock_step);
+
+    for (i = 0;i < ARRAY_SIZE(bench_rings);i ++) {
+        bench_ring(&bench_rings[i]);
+    }
+
+    printf("bench: done\n");
+}
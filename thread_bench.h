@@ -0,0 +1,26 @@
+/*
+    Microbenchmarks of the green thread primitives.
+
+    Each benchmark runs THREAD_BENCH_ROUNDS rounds at several thread
+    counts and prints one line per count:
+
+    COLLECTION - bench <name> threads <n> ops <ops> mean <c> stddev <c> min <c> max <c>
+
+    with cycles per operation. The same code runs in the driver
+    (THREAD_BENCH) and in the host build (host/host_bench).
+*/
+#ifndef THREAD_BENCH_H
+#define THREAD_BENCH_H
+
+#include "thread_lib.h"
+
+#define THREAD_BENCH_ROUNDS 16
+/* operations timed per round */
+#define THREAD_BENCH_OPS 1000
+
+/* Runs every benchmark. Must be called from a green thread after
+ * thread_initial(). Thread ids and stacks are not reclaimed by the
+ * runtime, so the whole suite creates a few hundred threads. */
+void thread_bench_run(allocman_t *allocman, vspace_t *vspace);
+
+#endif
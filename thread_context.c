@@ -0,0 +1,118 @@
+#include <assert.h>
+
+#include "thread_context.h"
+
+void thread_ctx_bouncer(void);
+
+#ifdef THREAD_CONTEXT_X86_64
+
+asm(
+    ".text\n"
+    ".global thread_ctx_switch\n"
+    ".type thread_ctx_switch, @function\n"
+"thread_ctx_switch:\n"
+    "mov (%rdi), %rsp\n"
+    "jmp *8(%rdi)\n"
+
+    ".global thread_ctx_swap\n"
+    ".type thread_ctx_swap, @function\n"
+"thread_ctx_swap:\n"
+    "push %rbp\n"
+    "push %rbx\n"
+    "push %r12\n"
+    "push %r13\n"
+    "push %r14\n"
+    "push %r15\n"
+    "mov %rsp, (%rdi)\n"
+    "lea 1f(%rip), %rax\n"
+    "mov %rax, 8(%rdi)\n"
+    "mov (%rsi), %rsp\n"
+    "jmp *8(%rsi)\n"
+"1:\n"
+    "pop %r15\n"
+    "pop %r14\n"
+    "pop %r13\n"
+    "pop %r12\n"
+    "pop %rbx\n"
+    "pop %rbp\n"
+    "ret\n"
+
+    /* entered with arg, func on the stack, popping them leaves it 16-byte aligned */
+    ".global thread_ctx_bouncer\n"
+    ".type thread_ctx_bouncer, @function\n"
+"thread_ctx_bouncer:\n"
+    "pop %rdi\n"
+    "pop %rax\n"
+    "xor %ebp, %ebp\n"
+    "call *%rax\n"
+    "call thread_exit@PLT\n"
+    "ud2\n"
+);
+
+#else
+
+asm(
+    ".text\n"
+    ".global thread_ctx_switch\n"
+    ".type thread_ctx_switch, @function\n"
+"thread_ctx_switch:\n"
+    "mov 4(%esp), %edx\n"
+    "mov (%edx), %esp\n"
+    "push 4(%edx)\n"
+    "ret\n"
+
+    ".global thread_ctx_swap\n"
+    ".type thread_ctx_swap, @function\n"
+"thread_ctx_swap:\n"
+    "mov 4(%esp), %ecx\n"
+    "mov 8(%esp), %edx\n"
+    "push %ebp\n"
+    "push %ebx\n"
+    "push %esi\n"
+    "push %edi\n"
+    "mov %esp, (%ecx)\n"
+    "mov (%edx), %esp\n"
+    "movl $1f, 4(%ecx)\n"
+    "push 4(%edx)\n"
+    "ret\n"
+"1:\n"
+    "pop %edi\n"
+    "pop %esi\n"
+    "pop %ebx\n"
+    "pop %ebp\n"
+    "ret\n"
+
+    /* entered with arg, func on the stack */
+    ".global thread_ctx_bouncer\n"
+    ".type thread_ctx_bouncer, @function\n"
+"thread_ctx_bouncer:\n"
+    "pop %eax\n"
+    "pop %ebx\n"
+    "push $0\n"
+    "xor %ebp, %ebp\n"
+    "push %eax\n"
+    "call *%ebx\n"
+    "call thread_exit\n"
+);
+
+#endif
+
+void
+thread_ctx_init(thread_ctx_t *ctx, void *stack_top, void *(*func)(void *), void *arg)
+{
+    uintptr_t *sp = stack_top;
+
+    assert(((uintptr_t) stack_top & 0xf) == 0);
+
+    /* what thread_ctx_bouncer pops: arg first, then func */
+    *-- sp = (uintptr_t) func;
+    *-- sp = (uintptr_t) arg;
+
+#ifdef THREAD_CONTEXT_X86_64
+    ctx->rsp = (uintptr_t) sp;
+    ctx->rip = (uintptr_t) thread_ctx_bouncer;
+#else
+    ctx->esp = (uintptr_t) sp;
+    ctx->eip = (uintptr_t) thread_ctx_bouncer;
+#endif
+}
@@ -0,0 +1,52 @@
+/*
+    Context switch for the green runtime, for ia32 and x86_64.
+
+    thread_ctx_swap(cur, next) pushes the caller's callee-saved
+    registers on its own stack, records the stack pointer and resume
+    address in cur and continues next. thread_ctx_switch(next) continues
+    next without saving anything, for a thread that is exiting. A new
+    thread starts in thread_ctx_bouncer, which calls func(arg) and then
+    thread_exit(); thread_ctx_init() lays out its first stack frame.
+
+    thread_lib.c has its own thread_context_t, swap_context,
+    switch_context and bouncer, and creates and switches every green
+    thread with them; the names here are separate ones. thread_lib.c is
+    not part of this tree and the driver is built for ia32, so nothing
+    but the swap microbenchmark uses this code.
+
+    CONFIG_ARCH_X86_64 selects the x86_64 code: rbx, rbp, r12-r15 are
+    saved, and thread_ctx_bouncer calls func with the stack 16-byte aligned as
+    the SysV ABI asks. Both only push below the current stack pointer,
+    the way a call does, so a leaf function's red zone is never touched.
+    FPU and SSE state is not switched, see thread_fpu.h.
+*/
+#ifndef THREAD_CONTEXT_H
+#define THREAD_CONTEXT_H
+
+#include <autoconf.h>
+#include <stdint.h>
+
+#if defined(CONFIG_ARCH_X86_64) || (!defined(CONFIG_ARCH_IA32) && defined(__x86_64__))
+#define THREAD_CONTEXT_X86_64
+#endif
+
+/* Only the stack pointer and resume address are stored here, the
+ * registers live on the thread's stack while it is switched out. */
+typedef struct thread_ctx_t {
+#ifdef THREAD_CONTEXT_X86_64
+    uint64_t rsp;
+    uint64_t rip;
+#else
+    uint32_t esp;
+    uint32_t eip;
+#endif
+} thread_ctx_t;
+
+void thread_ctx_swap(thread_ctx_t *cur, thread_ctx_t *next);
+void thread_ctx_switch(thread_ctx_t *next);
+
+/* Set ctx up to enter func(arg) on the stack below stack_top, which
+ * must be 16-byte aligned. */
+void thread_ctx_init(thread_ctx_t *ctx, void *stack_top, void *(*func)(void *), void *arg);
+
+#endif
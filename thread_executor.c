@@ -0,0 +1,146 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include <utils/util.h>
+
+#include "thread_executor.h"
+#include "thread_hooks.h"
+
+static executor_future_t exec_futures[EXECUTOR_FUTURES];
+static executor_future_t *exec_free;
+
+/* submitted tasks not yet taken by a worker */
+static executor_future_t *exec_queue[EXECUTOR_QUEUE];
+static int exec_head, exec_count;
+
+/* idle workers, submitters waiting for queue space, and for a future */
+static thread_lock_t *exec_work, *exec_space, *exec_future_list;
+
+static int exec_workers;
+static int exec_submitted, exec_completed, exec_full_waits;
+
+static void *
+executor_worker(void *arg)
+{
+    executor_future_t *f;
+
+    while (1) {
+        while (exec_count == 0) {
+            thread_sleep(exec_work, NULL);
+        }
+
+        f = exec_queue[exec_head];
+        exec_head = (exec_head + 1) % EXECUTOR_QUEUE;
+        exec_count --;
+        thread_wakeup(exec_space, NULL);
+
+        f->result = f->fn(f->arg);
+        f->done = 1;
+        exec_completed ++;
+
+        /* thread_wakeup() wakes one sleeper at a time */
+        while (f->waiting > 0) {
+            f->waiting --;
+            thread_wakeup(f->waiters, NULL);
+        }
+    }
+
+    return arg;
+}
+
+int
+executor_init(allocman_t *allocman, vspace_t *vspace, int workers)
+{
+    int i, t_id;
+
+    if (exec_work == NULL) {
+        exec_work = thread_lock_create();
+        exec_space = thread_lock_create();
+        exec_future_list = thread_lock_create();
+        if (exec_work == NULL || exec_space == NULL || exec_future_list == NULL) {
+            printf("Error: Cannot create the executor wait queues.\n");
+            return -1;
+        }
+
+        for (i = 0;i < EXECUTOR_FUTURES;i ++) {
+            exec_futures[i].waiters = thread_lock_create();
+            if (exec_futures[i].waiters == NULL) {
+                printf("Error: Cannot create the executor futures.\n");
+                return -1;
+            }
+            exec_futures[i].next = exec_free;
+            exec_free = &exec_futures[i];
+        }
+    }
+
+    while (exec_workers < workers) {
+        t_id = thread_create(allocman, vspace, executor_worker, NULL);
+        if (t_id < 0) {
+            printf("Error: Cannot create executor worker %d.\n", exec_workers);
+            return -1;
+        }
+        exec_workers ++;
+    }
+
+    return 0;
+}
+
+executor_future_t *
+executor_submit(void *(*fn)(void *), void *arg)
+{
+    executor_future_t *f;
+
+    assert(exec_workers > 0);
+
+    while (exec_free == NULL) {
+        thread_sleep(exec_future_list, NULL);
+    }
+    f = exec_free;
+    exec_free = f->next;
+
+    f->fn = fn;
+    f->arg = arg;
+    f->result = NULL;
+    f->done = 0;
+    f->waiting = 0;
+
+    while (exec_count == EXECUTOR_QUEUE) {
+        exec_full_waits ++;
+        thread_sleep(exec_space, NULL);
+    }
+    exec_queue[(exec_head + exec_count) % EXECUTOR_QUEUE] = f;
+    exec_count ++;
+    exec_submitted ++;
+
+    thread_wakeup(exec_work, NULL);
+
+    return f;
+}
+
+void *
+future_wait(executor_future_t *f)
+{
+    while (!f->done) {
+        f->waiting ++;
+        thread_sleep(f->waiters, NULL);
+    }
+
+    return f->result;
+}
+
+void
+future_release(executor_future_t *f)
+{
+    assert(f->done);
+
+    f->next = exec_free;
+    exec_free = f;
+    thread_wakeup(exec_future_list, NULL);
+}
+
+void
+executor_info(void)
+{
+    printf("COLLECTION - executor workers %d submitted %d completed %d queue full waits %d\n",
+           exec_workers, exec_submitted, exec_completed, exec_full_waits);
+}
@@ -0,0 +1,55 @@
+/*
+    Executor of short tasks on parked green worker threads.
+
+    executor_submit() queues fn(arg) and returns a future; a worker
+    runs it the next time the submitter blocks or yields, and
+    future_wait() sleeps until it is done. Workers are created once
+    and sleep on a wait queue when there is no work, so a task costs
+    no thread_create/thread_exit or stack allocation.
+
+    The queue holds EXECUTOR_QUEUE tasks; a submitter that finds it
+    full, or finds all EXECUTOR_FUTURES futures in use, sleeps until
+    a worker or future_release() makes room. A task must not wait on
+    a future of a task queued after it unless there are enough workers
+    to run both.
+*/
+#ifndef THREAD_EXECUTOR_H
+#define THREAD_EXECUTOR_H
+
+#include "thread_lib.h"
+#include "sync_prim.h"
+
+#ifndef EXECUTOR_WORKERS
+#define EXECUTOR_WORKERS 4
+#endif
+
+#define EXECUTOR_QUEUE 64
+#define EXECUTOR_FUTURES 256
+
+typedef struct executor_future_t {
+    void *(*fn)(void *);
+    void *arg;
+    void *result;
+    volatile int done;
+    /* threads asleep in future_wait() */
+    int waiting;
+    thread_lock_t *waiters;
+    struct executor_future_t *next;
+} executor_future_t;
+
+/* Start worker threads until there are workers of them, the first call
+ * also sets up the queue and the futures. Must run in a green thread
+ * after thread_initial(). */
+int executor_init(allocman_t *allocman, vspace_t *vspace, int workers);
+
+executor_future_t *executor_submit(void *(*fn)(void *), void *arg);
+
+/* the task's return value */
+void *future_wait(executor_future_t *f);
+
+/* give a waited-for future back for reuse */
+void future_release(executor_future_t *f);
+
+void executor_info(void);
+
+#endif
@@ -0,0 +1,3 @@
+#include "thread_ext.h"
+
+thread_ext_t thread_ext[THREAD_EXT_MAX];
@@ -0,0 +1,52 @@
+/*
+    Per green thread state of the driver's modules.
+
+    thread_t belongs to the runtime and has no room for it, so each
+    thread's share lives in one table indexed by thread id. A module
+    adds its fields to thread_ext_t rather than keeping a table of its
+    own. Entries are never cleared, thread ids are not reused by the
+    runtime.
+*/
+#ifndef THREAD_EXT_H
+#define THREAD_EXT_H
+
+#include <assert.h>
+
+#include "thread_lib.h"
+#include "thread_stats.h"
+
+/* thread ids that can have an entry, the size of the runtime's pool */
+#define THREAD_EXT_MAX 2000
+
+struct thread_msg_t;
+
+typedef struct thread_ext_t {
+    /* what the thread runs once thread_hooks_start() is done, see thread_hooks.h */
+    void *(*entry)(void *);
+    void *arg;
+    /* FPU save area, NULL until thread_fpu_enter(), see thread_fpu.h */
+    void *fpu;
+    /* message kept across a sleep, see thread_msg.h */
+    struct thread_msg_t *msg;
+    /* runtime accounting, see thread_stats.h */
+    thread_stats_t stats;
+} thread_ext_t;
+
+extern thread_ext_t thread_ext[THREAD_EXT_MAX];
+
+static inline thread_ext_t *
+thread_ext_get(int t_id)
+{
+    assert(t_id >= 0 && t_id < THREAD_EXT_MAX);
+
+    return &thread_ext[t_id];
+}
+
+/* the running thread's entry */
+static inline thread_ext_t *
+thread_ext_self(void)
+{
+    return thread_ext_get(pool->t_running->t_id);
+}
+
+#endif
@@ -0,0 +1,116 @@
+#include <autoconf.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "thread_ext.h"
+#include "thread_fpu.h"
+#include "thread_slab.h"
+
+/* the default MXCSR: all exceptions masked, round to nearest */
+#define THREAD_FPU_MXCSR 0x1f80
+
+int thread_fpu_owner = -1;
+
+static int fpu_users, fpu_saves, fpu_restores;
+
+static inline void
+fpu_save(void *area)
+{
+#ifdef CONFIG_FXSAVE
+    asm volatile("fxsave (%0)" :: "r" (area) : "memory");
+#else
+    asm volatile("fnsave (%0)" :: "r" (area) : "memory");
+#endif
+}
+
+static inline void
+fpu_restore(void *area)
+{
+#ifdef CONFIG_FXSAVE
+    asm volatile("fxrstor (%0)" :: "r" (area) : "memory");
+#else
+    asm volatile("frstor (%0)" :: "r" (area) : "memory");
+#endif
+}
+
+static inline void
+fpu_reset(void)
+{
+#ifdef CONFIG_FXSAVE
+    uint32_t mxcsr = THREAD_FPU_MXCSR;
+#endif
+
+    asm volatile("fninit" ::: "memory");
+#ifdef CONFIG_FXSAVE
+    asm volatile("ldmxcsr %0" :: "m" (mxcsr));
+#endif
+}
+
+void
+thread_fpu_switch(int t_id)
+{
+    thread_ext_t *ext = thread_ext_get(t_id);
+
+    if (thread_fpu_owner >= 0) {
+        fpu_save(thread_ext_get(thread_fpu_owner)->fpu);
+        fpu_saves ++;
+    }
+
+    if (ext->fpu != NULL) {
+        fpu_restore(ext->fpu);
+        fpu_restores ++;
+        thread_fpu_owner = t_id;
+    } else {
+        /* not the owner's control words either */
+        fpu_reset();
+        thread_fpu_owner = -1;
+    }
+}
+
+void
+thread_fpu_enter(void)
+{
+    int t_id = pool->t_running->t_id;
+    thread_ext_t *ext = thread_ext_get(t_id);
+
+    if (ext->fpu != NULL) {
+        return;
+    }
+
+    /* the hooks have saved any other owner before this thread ran */
+    assert(thread_fpu_owner < 0);
+
+    /* slab objects are cache-line aligned, FXSAVE wants 16 bytes */
+    ext->fpu = thread_slab_alloc(&thread_slab_fpu);
+    assert(ext->fpu != NULL);
+    fpu_users ++;
+    fpu_reset();
+
+    thread_fpu_owner = t_id;
+}
+
+void
+thread_fpu_leave(int t_id)
+{
+    thread_ext_t *ext = thread_ext_get(t_id);
+
+    if (ext->fpu == NULL) {
+        return;
+    }
+
+    /* nothing left to save */
+    if (thread_fpu_owner == t_id) {
+        thread_fpu_owner = -1;
+    }
+
+    thread_slab_free(&thread_slab_fpu, ext->fpu);
+    ext->fpu = NULL;
+}
+
+void
+thread_fpu_info(void)
+{
+    printf("COLLECTION - fpu threads %d saves %d restores %d area %d\n",
+           fpu_users, fpu_saves, fpu_restores, THREAD_FPU_AREA);
+}
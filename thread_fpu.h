@@ -0,0 +1,64 @@
+/*
+    FPU and SSE state of green threads.
+
+    swap_context() switches only the integer registers, as the ABI
+    requires of a function call. The FPU state moves in the switch
+    hooks instead (thread_hooks.h), which run every time a thread is
+    switched in, whoever it is.
+
+    A thread that keeps FPU/SSE state of its own (control words, or
+    values it expects to find again after a switch) calls
+    thread_fpu_enter() once, before it first touches that state. That
+    gives it a save area and a clean state. From then on it owns the
+    registers whenever it runs: they stay put while it runs again and
+    again, and are saved and reloaded only when another thread has run
+    in between.
+
+    Every other thread keeps nothing in the FPU across a switch, but may
+    still use it in between: SSE code the compiler or libc emit for
+    plain C (memcpy, struct copies, floating point). Before such a
+    thread runs after an owner, the owner's state is saved and the
+    registers are reset, so neither sees the other's state. While no
+    thread has called thread_fpu_enter(), a switch costs one compare
+    and nothing is ever saved. Areas go back to the slab cache with
+    thread_fpu_leave(), which the hooks call when a thread exits.
+*/
+#ifndef THREAD_FPU_H
+#define THREAD_FPU_H
+
+#include <autoconf.h>
+
+#include "thread_lib.h"
+#include "thread_ext.h"
+
+#ifdef CONFIG_FXSAVE
+#define THREAD_FPU_AREA 512
+#else
+/* FNSAVE, no SSE state */
+#define THREAD_FPU_AREA 108
+#endif
+
+/* thread whose state is in the registers, -1 for none worth saving */
+extern int thread_fpu_owner;
+
+void thread_fpu_switch(int t_id);
+
+/* The running thread keeps FPU/SSE state of its own from now on. */
+void thread_fpu_enter(void);
+
+/* switch hook: thread t_id runs again */
+static inline void
+thread_fpu_in(int t_id)
+{
+    if (thread_fpu_owner != t_id && (thread_fpu_owner >= 0 || thread_ext_get(t_id)->fpu != NULL)) {
+        thread_fpu_switch(t_id);
+    }
+}
+
+/* Thread t_id keeps no FPU state any more: it exits, or is done with it. */
+void thread_fpu_leave(int t_id);
+
+/* COLLECTION - fpu line: FPU threads, saves and restores */
+void thread_fpu_info(void);
+
+#endif
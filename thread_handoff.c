@@ -0,0 +1,55 @@
+#include <assert.h>
+
+#include "thread_handoff.h"
+#include "thread_hooks.h"
+#include "thread_lib_internal.h"
+
+int
+thread_switch_to(int t_id)
+{
+    thread_link_t *cur = pool->t_running;
+    thread_t *t;
+
+    assert(cur != NULL);
+
+    if (t_id == cur->t_id) {
+        return 0;
+    }
+
+    t = pool->get_thread(pool, t_id);
+    if (t == NULL || t->status != ready) {
+        return -1;
+    }
+
+    running_to_ready(cur);
+    ready_to_running(t);
+    co_current_id = t_id;
+    swap_context(cur->t->context, t->context);
+    thread_hooks_in();
+
+    return 0;
+}
+
+int
+thread_wakeup_and_switch(void *sync_prim)
+{
+    thread_sync_prim_t *list = sync_prim;
+    thread_link_t *cur = pool->t_running, *next;
+
+    assert(list != NULL);
+    assert(cur != NULL);
+
+    next = extract_first_waiting((thread_link_t **) &list->waiting_start,
+                                 (thread_link_t **) &list->waiting_end);
+    if (next == NULL) {
+        return 0;
+    }
+
+    running_to_ready(cur);
+    waiting_to_running(next);
+    co_current_id = next->t_id;
+    swap_context(cur->t->context, next->t->context);
+    thread_hooks_in();
+
+    return 1;
+}
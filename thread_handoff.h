@@ -0,0 +1,23 @@
+/*
+    Direct switches between green threads.
+
+    thread_sleep() and thread_yield() run whatever is at the head of the
+    ready queue. When the caller already knows which thread should run
+    next, e.g. the consumer waiting for the item it has just produced,
+    these swap straight into that thread: the caller goes to the tail
+    of the ready queue, the target never passes through it.
+*/
+#ifndef THREAD_HANDOFF_H
+#define THREAD_HANDOFF_H
+
+#include "thread_lib.h"
+
+/* Switch to the ready thread t_id. Returns 0 once the caller runs
+ * again, -1 without switching if t_id is not ready. */
+int thread_switch_to(int t_id);
+
+/* thread_wakeup() followed by a switch to the woken thread. Returns 1
+ * once the caller runs again, 0 if nobody was waiting on sync_prim. */
+int thread_wakeup_and_switch(void *sync_prim);
+
+#endif
@@ -0,0 +1,15 @@
+#include <utils/util.h>
+
+#include "thread_hooks.h"
+
+void *
+thread_hooks_start(void *arg UNUSED)
+{
+    thread_ext_t *ext = thread_ext_self();
+
+    thread_hooks_in();
+    ext->entry(ext->arg);
+    thread_exit();
+
+    return NULL;
+}
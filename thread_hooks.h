@@ -0,0 +1,164 @@
+/*
+    Driver work tied to green thread switches.
+
+    thread_lib.c switches threads but is not part of this tree, so it
+    cannot call back into the driver on a switch. Instead every runtime
+    call that can switch threads is wrapped here, and for any file that
+    includes this header the runtime's names stand for the wrappers. A
+    wrapper makes the call and then runs thread_hooks_in() in whichever
+    thread comes back. A new thread starts in thread_hooks_start(),
+    which runs the same hooks before the thread's own entry function.
+    That covers every point where a green thread can start running, so
+    no caller has to opt in.
+
+    The hooks are lazy, they only do work when the thread coming in is
+    not the one whose state is loaded: FPU registers (thread_fpu.h) and
+    the message in the IPC buffer (thread_msg.h). Driver code that
+    switches by itself (thread_handoff.c) calls thread_hooks_in() after
+    its swap_context().
+
+    thread_create() and thread_exit() are also where every thread's
+    stack is painted and its high-water mark recorded (thread_stack.h).
+    The same files take their locks and semaphores from the slab caches
+    when THREAD_SLAB is defined (thread_slab.h).
+*/
+#ifndef THREAD_HOOKS_H
+#define THREAD_HOOKS_H
+
+#include "thread_lib.h"
+#include "sync_prim.h"
+#include "thread_ext.h"
+#include "thread_fpu.h"
+#include "thread_msg.h"
+#include "thread_stack.h"
+#include "thread_slab.h"
+
+/* the running thread has just been switched in */
+static inline void
+thread_hooks_in(void)
+{
+    int t_id = pool->t_running->t_id;
+
+    thread_fpu_in(t_id);
+    thread_msg_in(t_id);
+}
+
+/* entry of every thread made through thread_create(), runs ext->entry */
+void *thread_hooks_start(void *arg);
+
+static inline int
+thread_hooks_create(allocman_t *allocman, vspace_t *vspace, void *(*func)(void *), void *arg)
+{
+    /* the new thread does not run before this returns */
+    int t_id = thread_create(allocman, vspace, thread_hooks_start, NULL);
+    thread_ext_t *ext;
+
+    if (t_id >= 0) {
+        ext = thread_ext_get(t_id);
+        ext->entry = func;
+        ext->arg = arg;
+        thread_stack_paint(t_id);
+    }
+
+    return t_id;
+}
+
+static inline int
+thread_hooks_exit(void)
+{
+    int t_id = pool->t_running->t_id;
+
+    thread_stack_record(t_id);
+    thread_fpu_leave(t_id);
+    thread_msg_leave(t_id);
+    /* gone, see thread_stack_pool_info() */
+    thread_ext_get(t_id)->entry = NULL;
+
+    return thread_exit();
+}
+
+static inline void
+thread_hooks_sleep(void *sync_prim, void *arg)
+{
+    thread_sleep(sync_prim, arg);
+    thread_hooks_in();
+}
+
+static inline void
+thread_hooks_wakeup_wait(void *sync_prim)
+{
+    thread_wakeup_wait(sync_prim);
+    thread_hooks_in();
+}
+
+static inline int
+thread_hooks_yield(void)
+{
+    int res = thread_yield();
+
+    thread_hooks_in();
+
+    return res;
+}
+
+static inline int
+thread_hooks_resume(int t_id)
+{
+    int res = thread_resume(t_id);
+
+    thread_hooks_in();
+
+    return res;
+}
+
+static inline int
+thread_hooks_join(int t_id)
+{
+    int res = thread_join(t_id);
+
+    thread_hooks_in();
+
+    return res;
+}
+
+static inline void
+thread_hooks_lock_acquire(thread_lock_t *lock)
+{
+    thread_lock_acquire(lock);
+    thread_hooks_in();
+}
+
+static inline void
+thread_hooks_lock_release_acquire(thread_lock_t *lock)
+{
+    thread_lock_release_acquire(lock);
+    thread_hooks_in();
+}
+
+static inline void
+thread_hooks_semaphore_P(thread_semaphore_t *s)
+{
+    thread_semaphore_P(s);
+    thread_hooks_in();
+}
+
+static inline void
+thread_hooks_cv_wait(void *cv, thread_lock_t *lock)
+{
+    thread_cv_wait(cv, lock);
+    thread_hooks_in();
+}
+
+#define thread_create thread_hooks_create
+#define thread_exit thread_hooks_exit
+#define thread_sleep thread_hooks_sleep
+#define thread_wakeup_wait thread_hooks_wakeup_wait
+#define thread_yield thread_hooks_yield
+#define thread_resume thread_hooks_resume
+#define thread_join thread_hooks_join
+#define thread_lock_acquire thread_hooks_lock_acquire
+#define thread_lock_release_acquire thread_hooks_lock_release_acquire
+#define thread_semaphore_P thread_hooks_semaphore_P
+#define thread_cv_wait thread_hooks_cv_wait
+
+#endif
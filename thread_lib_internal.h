@@ -0,0 +1,36 @@
+/*
+    thread_lib.c and sync_prim.c functions that thread_lib.h and
+    sync_prim.h leave out.
+
+    They are global in thread_lib.o: the steps thread_scheduler() takes
+    to move a thread between the running, ready and waiting states, the
+    wait list helpers and the context switch itself. Driver modules
+    that switch threads without going through the scheduler take them
+    from here, so every prototype is written down once. sync_prim.o
+    adds the pool bookkeeping every lock and semaphore goes through,
+    for the driver's own allocators (thread_slab.h). Keep these in step
+    with thread_lib.c and sync_prim.c.
+*/
+#ifndef THREAD_LIB_INTERNAL_H
+#define THREAD_LIB_INTERNAL_H
+
+#include "thread_lib.h"
+#include "sync_prim.h"
+
+/* run state moves, as thread_scheduler() does them */
+void running_to_ready(thread_link_t *linker);
+int ready_to_running(thread_t *t);
+int waiting_to_running(thread_link_t *linker);
+
+/* Unlink the head of the wait list start .. end, NULL if it is empty. */
+thread_link_t *extract_first_waiting(thread_link_t **start, thread_link_t **end);
+
+/* save the callee-saved registers into cur, continue from next */
+void swap_context(thread_context_t *cur, thread_context_t *next);
+
+/* clear a new lock's or semaphore's wait list, link it into the pool */
+void sync_prim_initial(thread_sync_prim_t *sync_prim);
+/* unlink it again, before it is freed */
+void sync_prim_destroy(thread_sync_prim_t *sync_prim);
+
+#endif
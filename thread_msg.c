@@ -0,0 +1,85 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thread_ext.h"
+#include "thread_msg.h"
+#include "thread_slab.h"
+
+int thread_msg_owner = -1;
+
+static int msg_saves, msg_words;
+
+void
+thread_msg_hold(seL4_MessageInfo_t info)
+{
+    int t_id = pool->t_running->t_id;
+    thread_ext_t *ext = thread_ext_get(t_id);
+    thread_msg_t *m;
+
+    m = ext->msg;
+    if (m == NULL) {
+        m = thread_slab_alloc(&thread_slab_msgs);
+        assert(m != NULL);
+        ext->msg = m;
+    }
+
+    m->info = info;
+    m->saved = 0;
+    thread_msg_owner = t_id;
+}
+
+void
+thread_msg_switch(int t_id)
+{
+    seL4_IPCBuffer *ipc = seL4_GetIPCBuffer();
+    thread_msg_t *m;
+    int len, caps;
+
+    /* the holder's message is still in the buffer, nobody has received since */
+    if (thread_msg_owner >= 0) {
+        m = thread_ext_get(thread_msg_owner)->msg;
+        len = seL4_MessageInfo_get_length(m->info);
+        caps = seL4_MessageInfo_get_extraCaps(m->info);
+        memcpy(m->words, ipc->msg, len * sizeof(seL4_Word));
+        memcpy(m->words + len, ipc->caps_or_badges, caps * sizeof(seL4_Word));
+        m->saved = 1;
+
+        msg_saves ++;
+        msg_words += len + caps;
+    }
+
+    m = thread_ext_get(t_id)->msg;
+    if (m != NULL && m->saved) {
+        len = seL4_MessageInfo_get_length(m->info);
+        caps = seL4_MessageInfo_get_extraCaps(m->info);
+        memcpy(ipc->msg, m->words, len * sizeof(seL4_Word));
+        memcpy(ipc->caps_or_badges, m->words + len, caps * sizeof(seL4_Word));
+        m->saved = 0;
+        thread_msg_owner = t_id;
+    } else {
+        thread_msg_owner = -1;
+    }
+}
+
+void
+thread_msg_leave(int t_id)
+{
+    thread_ext_t *ext = thread_ext_get(t_id);
+
+    if (thread_msg_owner == t_id) {
+        thread_msg_owner = -1;
+    }
+
+    if (ext->msg != NULL) {
+        thread_slab_free(&thread_slab_msgs, ext->msg);
+        ext->msg = NULL;
+    }
+}
+
+void
+thread_msg_info(void)
+{
+    printf("COLLECTION - msg saves %d words %d\n", msg_saves, msg_words);
+}
@@ -0,0 +1,56 @@
+/*
+    Message registers of green threads.
+
+    The green threads share the carrier thread's IPC buffer, so a
+    handler that is switched out between reading its request and
+    replying would find the buffer holding whichever message was
+    received last. A thread that receives a message calls
+    thread_msg_hold() with its info. From then on the switch hooks
+    (thread_hooks.h) keep that message: when another thread comes in
+    while it is in the buffer, the words in use (info's length and
+    extra caps, not the whole buffer) are copied to the holder's
+    buffer first, and they are written back when the holder runs
+    again. As long as the holder is the next thread to run, nothing is
+    copied.
+*/
+#ifndef THREAD_MSG_H
+#define THREAD_MSG_H
+
+#include <sel4/sel4.h>
+
+#include "thread_lib.h"
+#include "thread_ext.h"
+
+/* room for the longest message, so that saves come from one slab cache */
+typedef struct thread_msg_t {
+    seL4_MessageInfo_t info;
+    /* the words below are the message, not the IPC buffer */
+    int saved;
+    /* the message registers in use, then the extra caps or badges */
+    seL4_Word words[seL4_MsgMaxLength + seL4_MsgMaxExtraCaps];
+} thread_msg_t;
+
+/* thread whose message is in the IPC buffer, -1 for none */
+extern int thread_msg_owner;
+
+/* The running thread has just received the message info describes. */
+void thread_msg_hold(seL4_MessageInfo_t info);
+
+void thread_msg_switch(int t_id);
+
+/* switch hook: thread t_id runs again */
+static inline void
+thread_msg_in(int t_id)
+{
+    if (thread_msg_owner != t_id && (thread_msg_owner >= 0 || thread_ext_get(t_id)->msg != NULL)) {
+        thread_msg_switch(t_id);
+    }
+}
+
+/* thread t_id is about to exit */
+void thread_msg_leave(int t_id);
+
+/* COLLECTION - msg line: saves and words copied */
+void thread_msg_info(void);
+
+#endif
@@ -0,0 +1,159 @@
+#include <autoconf.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "thread_slab.h"
+#include "thread_fpu.h"
+#include "thread_msg.h"
+#include "thread_lib_internal.h"
+
+thread_slab_t thread_slab_fpu = THREAD_SLAB_INIT("fpu", THREAD_FPU_AREA);
+thread_slab_t thread_slab_msgs = THREAD_SLAB_INIT("msg", sizeof(thread_msg_t));
+thread_slab_t thread_slab_locks = THREAD_SLAB_INIT("lock", sizeof(thread_lock_t));
+thread_slab_t thread_slab_sems = THREAD_SLAB_INIT("semaphore", sizeof(thread_semaphore_t));
+
+#ifdef THREAD_SLAB
+
+static thread_slab_t *slab_caches[] = {
+    &thread_slab_fpu,
+    &thread_slab_msgs,
+    &thread_slab_locks,
+    &thread_slab_sems,
+};
+
+/* add one slab worth of objects to the free list */
+static int
+slab_grow(thread_slab_t *slab)
+{
+    char *mem;
+    size_t i, num = THREAD_SLAB_BYTES / slab->size;
+
+    assert(num > 0);
+    if (posix_memalign((void **) &mem, THREAD_SLAB_LINE, THREAD_SLAB_BYTES) != 0) {
+        printf("Error: Cannot allocate a slab for %s.\n", slab->name);
+        return -1;
+    }
+
+    for (i = 0;i < num;i ++) {
+        *(void **) (mem + i * slab->size) = slab->free;
+        slab->free = mem + i * slab->size;
+    }
+    slab->slabs ++;
+
+    return 0;
+}
+
+void *
+thread_slab_alloc(thread_slab_t *slab)
+{
+    void *obj;
+
+    if (slab->free == NULL && slab_grow(slab) != 0) {
+        return NULL;
+    }
+
+    obj = slab->free;
+    slab->free = *(void **) obj;
+
+    slab->live ++;
+    if (slab->live > slab->peak) {
+        slab->peak = slab->live;
+    }
+
+    return obj;
+}
+
+void
+thread_slab_free(thread_slab_t *slab, void *obj)
+{
+    if (obj == NULL) {
+        return;
+    }
+
+    *(void **) obj = slab->free;
+    slab->free = obj;
+    slab->live --;
+}
+
+int
+thread_slab_reserve(thread_slab_t *slab, int num)
+{
+    int per_slab = THREAD_SLAB_BYTES / slab->size;
+
+    while (slab->slabs * per_slab - slab->live < num) {
+        if (slab_grow(slab) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* as sync_prim.c sets them up and tears them down */
+thread_lock_t *
+thread_slab_lock_create(void)
+{
+    thread_lock_t *lock = thread_slab_alloc(&thread_slab_locks);
+
+    if (lock == NULL) {
+        return NULL;
+    }
+
+    sync_prim_initial(&lock->sync_prim);
+    lock->helder = -1;
+    lock->held = 0;
+
+    return lock;
+}
+
+void
+thread_slab_lock_destory(thread_lock_t *lock)
+{
+    assert(lock != NULL);
+    assert(lock->sync_prim.waiting_start == NULL);
+
+    sync_prim_destroy(&lock->sync_prim);
+    thread_slab_free(&thread_slab_locks, lock);
+}
+
+thread_semaphore_t *
+thread_slab_semaphore_create(void)
+{
+    thread_semaphore_t *s = thread_slab_alloc(&thread_slab_sems);
+
+    if (s == NULL) {
+        return NULL;
+    }
+
+    sync_prim_initial(&s->sync_prim);
+    s->count = 0;
+
+    return s;
+}
+
+void
+thread_slab_semaphore_destory(thread_semaphore_t *s)
+{
+    assert(s != NULL);
+    assert(s->sync_prim.waiting_start == NULL);
+
+    sync_prim_destroy(&s->sync_prim);
+    thread_slab_free(&thread_slab_sems, s);
+}
+
+void
+thread_slab_pool_info(void)
+{
+    unsigned i;
+
+    for (i = 0;i < ARRAY_SIZE(slab_caches);i ++) {
+        thread_slab_t *slab = slab_caches[i];
+
+        printf("COLLECTION - slab %s size %zu slabs %d bytes %lu live %d peak %d\n",
+               slab->name, slab->size, slab->slabs, (unsigned long) (slab->slabs * THREAD_SLAB_BYTES),
+               slab->live, slab->peak);
+    }
+}
+
+#endif /* THREAD_SLAB */
@@ -0,0 +1,89 @@
+/*
+    Type-specific slab caches for the objects the driver allocates per
+    green thread: FPU save areas (thread_fpu.c) and saved messages
+    (thread_msg.c), and for the runtime's locks and semaphores.
+
+    With THREAD_SLAB defined, each cache carves cache-line-aligned
+    objects out of page-sized slabs and keeps the freed ones on a free
+    list, so once a cache has grown, handing out an object does no
+    general-purpose allocation. Slabs are never returned. Without
+    THREAD_SLAB the caches fall back to posix_memalign/free with the
+    same alignment.
+
+    sync_prim.c mallocs its locks and semaphores. With THREAD_SLAB,
+    thread_lock_create() and thread_semaphore_create() and their
+    destroys stand for the versions here in every file that includes
+    this header: the same set up through sync_prim_initial(), the
+    object from a cache. Thread control blocks, contexts and join
+    records are malloc'd inside thread_lib.c, out of reach of the
+    driver, and stay so.
+*/
+#ifndef THREAD_SLAB_H
+#define THREAD_SLAB_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <utils/util.h>
+
+#include "sync_prim.h"
+
+#define THREAD_SLAB_LINE 64
+#define THREAD_SLAB_BYTES PAGE_SIZE_4K
+
+typedef struct thread_slab_t {
+    const char *name;
+    /* object size, rounded up to a cache line */
+    size_t size;
+    /* free objects, linked through their first word */
+    void *free;
+    int slabs;
+    int live;
+    int peak;
+} thread_slab_t;
+
+#define THREAD_SLAB_INIT(slab_name, bytes) \
+    { .name = slab_name, .size = ((bytes) + THREAD_SLAB_LINE - 1) & ~(THREAD_SLAB_LINE - 1) }
+
+/* one cache per object type */
+extern thread_slab_t thread_slab_fpu;
+extern thread_slab_t thread_slab_msgs;
+extern thread_slab_t thread_slab_locks;
+extern thread_slab_t thread_slab_sems;
+
+#ifdef THREAD_SLAB
+
+void *thread_slab_alloc(thread_slab_t *slab);
+void thread_slab_free(thread_slab_t *slab, void *obj);
+/* grow until num objects are free, e.g. before a benchmark */
+int thread_slab_reserve(thread_slab_t *slab, int num);
+void thread_slab_pool_info(void);
+
+/* sync_prim.c's create and destroy, the object from a cache */
+thread_lock_t *thread_slab_lock_create(void);
+void thread_slab_lock_destory(thread_lock_t *lock);
+thread_semaphore_t *thread_slab_semaphore_create(void);
+void thread_slab_semaphore_destory(thread_semaphore_t *s);
+
+#define thread_lock_create thread_slab_lock_create
+#define thread_lock_destory thread_slab_lock_destory
+#define thread_semaphore_create thread_slab_semaphore_create
+#define thread_semaphore_destory thread_slab_semaphore_destory
+
+#else
+
+static inline void *
+thread_slab_alloc(thread_slab_t *slab)
+{
+    void *obj;
+
+    return posix_memalign(&obj, THREAD_SLAB_LINE, slab->size) == 0 ? obj : NULL;
+}
+
+static inline void thread_slab_free(thread_slab_t *slab UNUSED, void *obj) { free(obj); }
+static inline int thread_slab_reserve(thread_slab_t *slab UNUSED, int num UNUSED) { return 0; }
+static inline void thread_slab_pool_info(void) {}
+
+#endif
+
+#endif
@@ -0,0 +1,133 @@
+#include <autoconf.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <utils/util.h>
+
+#include "thread_ext.h"
+#include "thread_stack.h"
+
+#ifdef STACK_PAINT
+
+typedef struct thread_stack_func_t {
+    void *(*func)(void *);
+    size_t max;
+    size_t total;
+    int samples;
+} thread_stack_func_t;
+
+static thread_stack_func_t stack_funcs[THREAD_STACK_FUNCS];
+
+/* the initial frame (entry and argument) sits just below the top */
+static inline uint32_t *
+stack_top(thread_t *t)
+{
+    return (uint32_t *) ((uintptr_t) t->stack_top + 2 * sizeof(uint32_t));
+}
+
+/* the lowest word holds the context pointer, leave it alone */
+static inline uint32_t *
+stack_bottom(thread_t *t)
+{
+    return (uint32_t *) ((uintptr_t) stack_top(t) - THREAD_STACK_SIZE) + 1;
+}
+
+/*
+    Fill the unused part of a new thread's stack with the pattern.
+    Must be called before the thread runs for the first time.
+*/
+void
+thread_stack_paint(int t_id)
+{
+    thread_t *t = pool->addrs[t_id];
+    assert(t != NULL);
+
+    for (uint32_t *p = stack_bottom(t); p < (uint32_t *) t->stack_top; p ++) {
+        *p = THREAD_STACK_PATTERN;
+    }
+}
+
+/*
+    Return the deepest stack use of the thread so far, in bytes.
+*/
+size_t
+thread_stack_usage(int t_id)
+{
+    thread_t *t = pool->addrs[t_id];
+    uint32_t *p;
+
+    assert(t != NULL);
+
+    for (p = stack_bottom(t); p < stack_top(t) && *p == THREAD_STACK_PATTERN; p ++);
+
+    return (uintptr_t) stack_top(t) - (uintptr_t) p;
+}
+
+/* fold one thread's use into the entry of its function in funcs */
+static void
+stack_fold(thread_stack_func_t *funcs, void *(*func)(void *), size_t used)
+{
+    int i;
+
+    for (i = 0;i < THREAD_STACK_FUNCS;i ++) {
+        if (funcs[i].func == func || funcs[i].func == NULL) {
+            break;
+        }
+    }
+
+    if (i == THREAD_STACK_FUNCS) {
+        ZF_LOGW("Too many entry functions to track stack use of %p", func);
+        return;
+    }
+
+    funcs[i].func = func;
+    funcs[i].max = MAX(funcs[i].max, used);
+    funcs[i].total += used;
+    funcs[i].samples ++;
+}
+
+/* threads made through the hooks all start in thread_hooks_start() */
+static void *
+stack_func(int t_id)
+{
+    thread_ext_t *ext = thread_ext_get(t_id);
+
+    return ext->entry != NULL ? ext->entry : pool->addrs[t_id]->start_routine;
+}
+
+/*
+    Scan the stack of t_id and fold the result into its entry function.
+    The exit hook calls it for every thread (thread_hooks.h).
+*/
+void
+thread_stack_record(int t_id)
+{
+    stack_fold(stack_funcs, stack_func(t_id), thread_stack_usage(t_id));
+}
+
+/*
+    Print the stack high-water marks per entry function: the threads
+    that have exited, plus those still alive scanned now.
+*/
+void
+thread_stack_pool_info(void)
+{
+    thread_stack_func_t funcs[THREAD_STACK_FUNCS];
+    int t_id;
+
+    memcpy(funcs, stack_funcs, sizeof(funcs));
+    for (t_id = 0;t_id < THREAD_EXT_MAX;t_id ++) {
+        if (thread_ext[t_id].entry != NULL) {
+            stack_fold(funcs, thread_ext[t_id].entry, thread_stack_usage(t_id));
+        }
+    }
+
+    for (int i = 0;i < THREAD_STACK_FUNCS && funcs[i].func != NULL;i ++) {
+        printf("COLLECTION - stack %p threads %d max %zu avg %zu of %zu\n",
+               funcs[i].func, funcs[i].samples, funcs[i].max,
+               funcs[i].total / funcs[i].samples, (size_t) THREAD_STACK_SIZE);
+    }
+}
+
+#endif /* STACK_PAINT */
@@ -0,0 +1,44 @@
+/*
+    Stack high-water-mark measurement for green threads.
+
+    With STACK_PAINT defined every new thread stack is filled with a known
+    pattern; scanning for the first overwritten word gives the deepest
+    point the thread ever reached. Results are folded per entry function.
+    The create and exit hooks (thread_hooks.h) paint and record every
+    thread, server threads, executor workers and benchmark threads
+    alike.
+*/
+#ifndef THREAD_STACK_H
+#define THREAD_STACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utils/util.h>
+
+#include "thread_lib.h"
+
+/* size of a green thread stack, must match thread_create() */
+#define THREAD_STACK_SIZE (16 * PAGE_SIZE_4K)
+#define THREAD_STACK_PATTERN 0xCAFEF00D
+
+/* number of distinct entry functions tracked */
+#define THREAD_STACK_FUNCS 16
+
+#ifdef STACK_PAINT
+
+void thread_stack_paint(int t_id);
+size_t thread_stack_usage(int t_id);
+void thread_stack_record(int t_id);
+void thread_stack_pool_info(void);
+
+#else
+
+static inline void thread_stack_paint(int t_id UNUSED) {}
+static inline size_t thread_stack_usage(int t_id UNUSED) { return 0; }
+static inline void thread_stack_record(int t_id UNUSED) {}
+static inline void thread_stack_pool_info(void) {}
+
+#endif
+
+#endif
@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "thread_ext.h"
+#include "thread_stats.h"
+#include "thread_trace.h"
+#include "sync_prim.h"
+
+static const char *thread_stats_states[] = {
+    [STATS_RUNNING] = "running",
+    [STATS_WAITING] = "waiting",
+    [STATS_LOCK_WAITING] = "lock",
+    [STATS_EXITED] = "exited",
+};
+
+/* the running thread stops running at ts */
+static inline void
+stats_switch_out(thread_stats_t *s, uint64_t ts)
+{
+    s->on_cpu += ts - s->last;
+    s->switches_out ++;
+    s->last = ts;
+}
+
+/* the thread starts running at ts */
+static inline void
+stats_switch_in(thread_stats_t *s, uint64_t ts)
+{
+    s->switches_in ++;
+    s->state = STATS_RUNNING;
+    s->last = ts;
+}
+
+/*
+    Account a traced scheduler event.
+    Called by thread_trace_id() with the timestamp of the trace record.
+*/
+void
+thread_stats_event(int event, int t_id, void *obj, uint64_t ts)
+{
+    thread_stats_t *s;
+    thread_link_t *head;
+
+    if (t_id < 0 || t_id >= THREAD_EXT_MAX) {
+        return;
+    }
+
+    s = &thread_ext[t_id].stats;
+
+    switch (event) {
+        case TRACE_CREATE:
+        /* a new thread is ready straight away */
+        memset(s, 0, sizeof(*s));
+        s->state = STATS_WAITING;
+        s->last = ts;
+        s->woken = ts;
+        break;
+
+        case TRACE_SWITCH_IN:
+        if (s->state == STATS_WAITING && s->woken != 0 && s->woken >= s->last) {
+            s->waiting += s->woken - s->last;
+            s->ready += ts - s->woken;
+        } else {
+            s->waiting += ts - s->last;
+        }
+        s->woken = 0;
+        stats_switch_in(s, ts);
+        break;
+
+        case TRACE_SLEEP:
+        stats_switch_out(s, ts);
+        s->state = STATS_WAITING;
+        break;
+
+        case TRACE_WAKEUP:
+        /* thread_wakeup() takes the head of the wait list */
+        head = ((thread_sync_prim_t *) obj)->waiting_start;
+        if (head != NULL && head->t_id >= 0 && head->t_id < THREAD_EXT_MAX) {
+            thread_ext[head->t_id].stats.woken = ts;
+        }
+        break;
+
+        case TRACE_LOCK_WAIT:
+        s->on_cpu += ts - s->last;
+        s->last = ts;
+        s->lock_blocked = ((thread_lock_t *) obj)->held;
+        if (s->lock_blocked) {
+            s->switches_out ++;
+        }
+        s->state = STATS_LOCK_WAITING;
+        break;
+
+        case TRACE_LOCK_ACQUIRED:
+        s->lock_wait += ts - s->last;
+        if (s->lock_blocked) {
+            s->switches_in ++;
+        }
+        s->state = STATS_RUNNING;
+        s->last = ts;
+        break;
+
+        case TRACE_EXIT:
+        stats_switch_out(s, ts);
+        s->state = STATS_EXITED;
+        break;
+    }
+}
+
+/*
+    Copy the accounting of thread t_id.
+    Return 0 if the thread has never been seen.
+*/
+int
+thread_stats_get(int t_id, thread_stats_t *stats)
+{
+    if (t_id < 0 || t_id >= THREAD_EXT_MAX || thread_ext[t_id].stats.last == 0) {
+        return 0;
+    }
+
+    *stats = thread_ext[t_id].stats;
+
+    return 1;
+}
+
+/*
+    thread_info() plus the runtime accounting of the thread.
+*/
+void
+thread_stats_info(int t_id)
+{
+    thread_stats_t s;
+
+    thread_info(t_id);
+
+    if (! thread_stats_get(t_id, &s)) {
+        printf("No accounting for thread %d\n", t_id);
+        return;
+    }
+
+    printf("Thread %d %s: cpu %llu ready %llu waiting %llu lock %llu in %u out %u\n",
+           t_id, thread_stats_states[s.state], s.on_cpu, s.ready, s.waiting, s.lock_wait,
+           s.switches_in, s.switches_out);
+}
+
+/*
+    One line of accounting for every thread seen so far.
+*/
+void
+thread_stats_pool_info(void)
+{
+    for (int i = 0;i < THREAD_EXT_MAX;i ++) {
+        thread_stats_t *s = &thread_ext[i].stats;
+
+        if (s->last == 0) {
+            continue;
+        }
+
+        printf("COLLECTION - thread %d %s cpu %llu ready %llu waiting %llu lock %llu in %u out %u\n",
+               i, thread_stats_states[s->state], s->on_cpu, s->ready, s->waiting, s->lock_wait,
+               s->switches_in, s->switches_out);
+    }
+}
+
+/*
+    Export the accounting of every thread seen so far into page.
+    Return the number of threads written; threads that do not fit are
+    only counted in page->total.
+*/
+int
+thread_stats_snapshot(void *page, size_t size)
+{
+    thread_stats_page_t *snap = page;
+    uint32_t max = (size - sizeof(*snap)) / sizeof(thread_stats_record_t);
+
+    snap->num = 0;
+    snap->total = 0;
+
+    for (int i = 0;i < THREAD_EXT_MAX;i ++) {
+        thread_stats_t *s = &thread_ext[i].stats;
+
+        if (s->last == 0) {
+            continue;
+        }
+
+        snap->total ++;
+        if (snap->num == max) {
+            continue;
+        }
+
+        thread_stats_record_t *rec = &snap->threads[snap->num ++];
+        rec->t_id = i;
+        rec->state = s->state;
+        rec->switches_in = s->switches_in;
+        rec->switches_out = s->switches_out;
+        rec->on_cpu = s->on_cpu;
+        rec->ready = s->ready;
+        rec->waiting = s->waiting;
+        rec->lock_wait = s->lock_wait;
+    }
+
+    snap->timestamp = rdtsc();
+
+    return snap->num;
+}
@@ -0,0 +1,63 @@
+/*
+    Per green thread runtime accounting.
+
+    With THREAD_STATS defined, fed from the scheduler trace points (see
+    thread_trace.h), so every transition that is traced is also
+    accounted. Without it a trace point stays a ring store and nothing
+    is accounted. Times are in cycles.
+*/
+#ifndef THREAD_STATS_H
+#define THREAD_STATS_H
+
+#include <stdint.h>
+
+#include "thread_lib.h"
+
+typedef enum {
+    STATS_RUNNING = 0,
+    STATS_WAITING,
+    STATS_LOCK_WAITING,
+    STATS_EXITED,
+} thread_stats_state_t;
+
+typedef struct thread_stats_t {
+    uint64_t on_cpu;
+    uint64_t ready;
+    uint64_t waiting;
+    uint64_t lock_wait;
+    uint32_t switches_in;
+    uint32_t switches_out;
+
+    /* bookkeeping */
+    uint64_t last;
+    uint64_t woken;
+    int state;
+    int lock_blocked;
+} thread_stats_t;
+
+/* one entry of the exported snapshot page */
+typedef struct thread_stats_record_t {
+    uint32_t t_id;
+    uint32_t state;
+    uint32_t switches_in;
+    uint32_t switches_out;
+    uint64_t on_cpu;
+    uint64_t ready;
+    uint64_t waiting;
+    uint64_t lock_wait;
+} thread_stats_record_t;
+
+typedef struct thread_stats_page_t {
+    uint64_t timestamp;
+    uint32_t num;
+    uint32_t total;
+    thread_stats_record_t threads[];
+} thread_stats_page_t;
+
+void thread_stats_event(int event, int t_id, void *obj, uint64_t ts);
+int thread_stats_get(int t_id, thread_stats_t *stats);
+void thread_stats_info(int t_id);
+void thread_stats_pool_info(void);
+int thread_stats_snapshot(void *page, size_t size);
+
+#endif
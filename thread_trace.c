@@ -0,0 +1,50 @@
+#include <stdio.h>
+
+#include "thread_trace.h"
+
+thread_trace_t thread_trace_ring[THREAD_TRACE_SIZE];
+uint32_t thread_trace_head;
+
+static const char *thread_trace_names[] = {
+    [TRACE_CREATE] = "create",
+    [TRACE_EXIT] = "exit",
+    [TRACE_SWITCH_IN] = "switch_in",
+    [TRACE_SLEEP] = "sleep",
+    [TRACE_WAKEUP] = "wakeup",
+    [TRACE_LOCK_WAIT] = "lock_wait",
+    [TRACE_LOCK_ACQUIRED] = "lock_acquired",
+    [TRACE_LOCK_RELEASE] = "lock_release",
+};
+
+/*
+    Drop all recorded events.
+*/
+void
+thread_trace_reset(void)
+{
+    thread_trace_head = 0;
+}
+
+/*
+    Print the ring, oldest record first.
+    Format: TRACE <ts> <event> <t_id> <obj>
+*/
+void
+thread_trace_dump(void)
+{
+    uint32_t i = 0;
+
+    if (thread_trace_head > THREAD_TRACE_SIZE) {
+        i = thread_trace_head - THREAD_TRACE_SIZE;
+    }
+
+    printf("TRACE begin %u dropped %u\n", thread_trace_head, i);
+
+    for (; i != thread_trace_head; i ++) {
+        thread_trace_t *rec = &thread_trace_ring[i & (THREAD_TRACE_SIZE - 1)];
+
+        printf("TRACE %llu %s %u 0x%x\n", rec->ts, thread_trace_names[rec->event], rec->t_id, rec->obj);
+    }
+
+    printf("TRACE end\n");
+}
@@ -0,0 +1,68 @@
+/*
+    Scheduler trace ring for the green thread library.
+
+    Every record is 16 bytes and recording is a handful of stores, so the
+    ring is always on. The per-thread accounting of thread_stats.h runs
+    at the trace points too, but only with THREAD_STATS defined. thread_trace_dump() prints the ring over serial as
+    "TRACE" lines; trace_to_chrome.py turns a captured log into a
+    Chrome/Perfetto trace.
+*/
+#ifndef THREAD_TRACE_H
+#define THREAD_TRACE_H
+
+#include <stdint.h>
+
+#include "thread_lib.h"
+#include "thread_stats.h"
+
+/* number of records kept, must be a power of two */
+#define THREAD_TRACE_SIZE 4096
+
+typedef enum {
+    TRACE_CREATE = 0,
+    TRACE_EXIT,
+    TRACE_SWITCH_IN,
+    TRACE_SLEEP,
+    TRACE_WAKEUP,
+    TRACE_LOCK_WAIT,
+    TRACE_LOCK_ACQUIRED,
+    TRACE_LOCK_RELEASE,
+} thread_trace_event_t;
+
+typedef struct thread_trace_t {
+    uint64_t ts;
+    uint16_t event;
+    uint16_t t_id;
+    uint32_t obj;
+} thread_trace_t;
+
+extern thread_trace_t thread_trace_ring[THREAD_TRACE_SIZE];
+extern uint32_t thread_trace_head;
+
+/* record an event for thread t_id against obj (a wait list, lock or thread id) */
+static inline void
+thread_trace_id(thread_trace_event_t event, int t_id, void *obj)
+{
+    thread_trace_t *rec = &thread_trace_ring[thread_trace_head ++ & (THREAD_TRACE_SIZE - 1)];
+
+    rec->ts = rdtsc();
+    rec->event = event;
+    rec->t_id = t_id;
+    rec->obj = (uint32_t) (uintptr_t) obj;
+
+#ifdef THREAD_STATS
+    thread_stats_event(event, t_id, obj, rec->ts);
+#endif
+}
+
+/* record an event for the running thread */
+static inline void
+thread_trace(thread_trace_event_t event, void *obj)
+{
+    thread_trace_id(event, pool->t_running->t->t_id, obj);
+}
+
+void thread_trace_reset(void);
+void thread_trace_dump(void);
+
+#endif
@@ -0,0 +1,66 @@
+#!/usr/bin/env python
+"""
+Convert the TRACE lines printed by thread_trace_dump() into a Chrome trace
+(load it in chrome://tracing or ui.perfetto.dev).
+
+    python trace_to_chrome.py output --mhz 3400 > trace.json
+
+Each green thread is one track. Sleeps (sleep -> switch_in) and lock waits
+(lock_wait -> lock_acquired) become slices, everything else is an instant.
+"""
+
+import argparse
+import json
+import sys
+
+SLICES = {
+    'sleep': ('switch_in', 'sleep'),
+    'lock_wait': ('lock_acquired', 'lock wait'),
+}
+
+
+def parse(lines):
+    for line in lines:
+        fields = line.split()
+        if len(fields) != 5 or fields[0] != 'TRACE' or not fields[1].isdigit():
+            continue
+        yield int(fields[1]), fields[2], int(fields[3]), fields[4]
+
+
+def convert(records, mhz):
+    events = []
+    opened = {}
+    base = None
+
+    for ts, event, t_id, obj in records:
+        if base is None:
+            base = ts
+        us = (ts - base) / float(mhz)
+
+        pending = opened.get(t_id)
+        if pending is not None and pending[0] == event:
+            del opened[t_id]
+            events.append({'name': pending[1], 'ph': 'E', 'ts': us, 'pid': 0, 'tid': t_id})
+
+        if event in SLICES:
+            opened[t_id] = SLICES[event]
+            events.append({'name': SLICES[event][1], 'ph': 'B', 'ts': us, 'pid': 0, 'tid': t_id,
+                           'args': {'obj': obj}})
+        else:
+            events.append({'name': event, 'ph': 'i', 's': 't', 'ts': us, 'pid': 0, 'tid': t_id,
+                           'args': {'obj': obj}})
+
+    return {'traceEvents': events, 'displayTimeUnit': 'ns'}
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('log', nargs='?', type=argparse.FileType('r'), default=sys.stdin)
+    parser.add_argument('--mhz', type=float, default=3400, help='TSC frequency of the target')
+    args = parser.parse_args()
+
+    json.dump(convert(parse(args.log), args.mhz), sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
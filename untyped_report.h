@@ -0,0 +1,57 @@
+/*
+    Untyped report shared by the driver and the test processes.
+
+    A test that knows which of its untypeds it retyped sends its result
+    with untyped_report_send() instead of the plain one-word result:
+    MR0 is the result, MR1 UNTYPED_REPORT_MAGIC and the rest a bitmap,
+    bit i for untypeds.start + i. The driver then revokes only those
+    untypeds. The magic word and the exact length tell the report from
+    any other result message, so a longer result is never taken for a
+    bitmap; without a report every untyped counts as used.
+*/
+#ifndef UNTYPED_REPORT_H
+#define UNTYPED_REPORT_H
+
+#include <autoconf.h>
+
+#include <sel4/sel4.h>
+#include <utils/util.h>
+
+#define UNTYPED_REPORT_MAGIC 0x55545950 /* "UTYP" */
+
+#define UNTYPED_REPORT_WORDS \
+    ((CONFIG_MAX_NUM_BOOTINFO_UNTYPED_CAPS + seL4_WordBits - 1) / seL4_WordBits)
+
+/* result, magic, bitmap */
+#define UNTYPED_REPORT_LENGTH (2 + UNTYPED_REPORT_WORDS)
+
+compile_time_assert(untyped_report_fits, UNTYPED_REPORT_LENGTH <= seL4_MsgMaxLength);
+
+/* untyped i of the test's untypeds.start .. end has been retyped */
+static inline void
+untyped_report_set(seL4_Word *dirty, int i)
+{
+    dirty[i / seL4_WordBits] |= BIT(i % seL4_WordBits);
+}
+
+static inline int
+untyped_report_is(seL4_MessageInfo_t info)
+{
+    return seL4_MessageInfo_get_label(info) == seL4_Fault_NullFault &&
+           seL4_MessageInfo_get_length(info) == UNTYPED_REPORT_LENGTH &&
+           seL4_GetMR(1) == UNTYPED_REPORT_MAGIC;
+}
+
+/* the test's last message: its result and the untypeds it retyped */
+static inline void
+untyped_report_send(seL4_CPtr endpoint, seL4_Word result, const seL4_Word *dirty)
+{
+    seL4_SetMR(0, result);
+    seL4_SetMR(1, UNTYPED_REPORT_MAGIC);
+    for (int i = 0; i < UNTYPED_REPORT_WORDS; i++) {
+        seL4_SetMR(2 + i, dirty[i]);
+    }
+    seL4_Send(endpoint, seL4_MessageInfo_new(seL4_Fault_NullFault, 0, 0, UNTYPED_REPORT_LENGTH));
+}
+
+#endif
@@ -0,0 +1,225 @@
+/*
+    Workload description shared by the driver and the clients.
+
+    The driver fills a workload_t from the WORKLOAD_* macros (override
+    them with -D) and places it in the init frame, right after the
+    test_init_data_t. Clients get the frame address as argv[3], and the
+    same workload in the reply to their INIT (workload_get_mrs()), which
+    is all a client needs. Each client then calls workload_next() to
+    pick its next request and the delay before sending it.
+
+    The mix is over clients: every client sends one kind of request. A
+    client that mixed producer and consumer requests could deadlock the
+    CONSUMER_PRODUCER server, with every client waiting on a full buffer.
+    In that mode keep the producer and consumer shares equal, or the last
+    requests sleep forever.
+*/
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <sel4/sel4.h>
+
+#define WORKLOAD_MAGIC 0x574b4c44 /* "WKLD" */
+
+/* where the workload sits in the init frame (needs test_init_data.h) */
+#define WORKLOAD_INIT_OFFSET \
+    ((sizeof(test_init_data_t) + sizeof(seL4_Word) - 1) & ~(sizeof(seL4_Word) - 1))
+
+#ifndef WORKLOAD_CLIENTS
+#define WORKLOAD_CLIENTS 6
+#endif
+
+/* how many of the clients are logical clients hosted in the driver
+ * (local_client.h) rather than spawned processes */
+#ifndef WORKLOAD_LOCAL_CLIENTS
+#define WORKLOAD_LOCAL_CLIENTS 0
+#endif
+
+/* requests per client, TMNT not included */
+#ifndef WORKLOAD_OPS
+#define WORKLOAD_OPS 1000
+#endif
+
+/* request mix, relative shares */
+#ifndef WORKLOAD_PRODUCER
+#ifdef CONSUMER_PRODUCER
+#define WORKLOAD_PRODUCER 1
+#define WORKLOAD_CONSUMER 1
+#define WORKLOAD_SEND_WAIT 0
+#else
+#define WORKLOAD_PRODUCER 0
+#define WORKLOAD_CONSUMER 0
+#define WORKLOAD_SEND_WAIT 1
+#endif
+#endif
+
+/* cycles a client spins between two requests */
+#ifndef WORKLOAD_THINK
+#define WORKLOAD_THINK 0
+#endif
+
+/* open loop: a client's requests are due every WORKLOAD_INTERVAL cycles
+ * whether or not the earlier ones have been answered; 0 is closed loop */
+#ifndef WORKLOAD_INTERVAL
+#define WORKLOAD_INTERVAL 0
+#endif
+
+/* WORKLOAD_BURST requests back to back, then WORKLOAD_BURST_GAP cycles
+ * idle; 0 disables bursts and WORKLOAD_THINK applies */
+#ifndef WORKLOAD_BURST
+#define WORKLOAD_BURST 0
+#endif
+#ifndef WORKLOAD_BURST_GAP
+#define WORKLOAD_BURST_GAP 0
+#endif
+
+/* items a PRODUCER/CONSUMER request asks to move, needs a BATCH_OPS
+ * server; 1 sends the plain one-item requests */
+#ifndef WORKLOAD_BATCH
+#define WORKLOAD_BATCH 1
+#endif
+
+enum workload_kind {
+    WORKLOAD_KIND_PRODUCER,
+    WORKLOAD_KIND_CONSUMER,
+    WORKLOAD_KIND_SEND_WAIT,
+    WORKLOAD_KINDS,
+    /* all requests sent, send TMNT */
+    WORKLOAD_KIND_DONE = WORKLOAD_KINDS,
+};
+
+typedef struct workload_t {
+    seL4_Word magic;
+    seL4_Word clients;
+    seL4_Word local;
+    seL4_Word ops;
+    seL4_Word mix[WORKLOAD_KINDS];
+    seL4_Word think;
+    seL4_Word burst;
+    seL4_Word burst_gap;
+    seL4_Word interval;
+    seL4_Word batch;
+} workload_t;
+
+/* where the INIT reply has it, after the client id and the client 0 flag */
+#define WORKLOAD_INIT_MR 2
+
+/* message registers a workload_t takes */
+#define WORKLOAD_WORDS (sizeof(workload_t) / sizeof(seL4_Word))
+
+static inline void
+workload_set_mrs(const workload_t *w, int first)
+{
+    const seL4_Word *words = (const seL4_Word *) w;
+    unsigned i;
+
+    for (i = 0;i < WORKLOAD_WORDS;i ++) {
+        seL4_SetMR(first + i, words[i]);
+    }
+}
+
+/* the workload sent with workload_set_mrs(), -1 if there is none */
+static inline int
+workload_get_mrs(workload_t *w, seL4_MessageInfo_t info, int first)
+{
+    seL4_Word *words = (seL4_Word *) w;
+    unsigned i;
+
+    if (seL4_MessageInfo_get_length(info) < first + WORKLOAD_WORDS) {
+        return -1;
+    }
+    for (i = 0;i < WORKLOAD_WORDS;i ++) {
+        words[i] = seL4_GetMR(first + i);
+    }
+
+    return w->magic == WORKLOAD_MAGIC ? 0 : -1;
+}
+
+/* per client generator state */
+typedef struct workload_client_t {
+    seL4_Word sent;
+    int kind;
+} workload_client_t;
+
+static inline void
+workload_default(workload_t *w)
+{
+    w->magic = WORKLOAD_MAGIC;
+    w->clients = WORKLOAD_CLIENTS;
+    w->local = WORKLOAD_LOCAL_CLIENTS;
+    w->ops = WORKLOAD_OPS;
+    w->mix[WORKLOAD_KIND_PRODUCER] = WORKLOAD_PRODUCER;
+    w->mix[WORKLOAD_KIND_CONSUMER] = WORKLOAD_CONSUMER;
+    w->mix[WORKLOAD_KIND_SEND_WAIT] = WORKLOAD_SEND_WAIT;
+    w->think = WORKLOAD_THINK;
+    w->burst = WORKLOAD_BURST;
+    w->burst_gap = WORKLOAD_BURST_GAP;
+    w->interval = WORKLOAD_INTERVAL;
+    w->batch = WORKLOAD_BATCH;
+}
+
+/* Smooth weighted round robin over the client ids: any run of clients
+ * gets the kinds in proportion to the mix, without a random number
+ * generator. */
+static inline void
+workload_client_init(const workload_t *w, workload_client_t *c, int client_id)
+{
+    int32_t credit[WORKLOAD_KINDS] = {0};
+    int32_t total = 0;
+    int i, n, best = 0;
+
+    for (i = 0;i < WORKLOAD_KINDS;i ++) {
+        total += w->mix[i];
+    }
+
+    for (n = 0;n <= client_id;n ++) {
+        best = 0;
+        for (i = 0;i < WORKLOAD_KINDS;i ++) {
+            credit[i] += w->mix[i];
+            if (credit[i] > credit[best]) {
+                best = i;
+            }
+        }
+        credit[best] -= total;
+    }
+
+    memset(c, 0, sizeof(*c));
+    c->kind = best;
+}
+
+/* Next request of a client and the cycles to wait before sending it. */
+static inline int
+workload_next(const workload_t *w, workload_client_t *c, uint64_t *delay)
+{
+    if (c->sent == w->ops) {
+        *delay = 0;
+        return WORKLOAD_KIND_DONE;
+    }
+
+    if (w->burst != 0) {
+        *delay = (c->sent != 0 && c->sent % w->burst == 0) ? w->burst_gap : 0;
+    } else {
+        *delay = c->sent != 0 ? w->think : 0;
+    }
+    c->sent ++;
+
+    return c->kind;
+}
+
+/*
+    Open loop: when the request just returned by workload_next() is due,
+    for a client that started at start. A client spins until then, calls,
+    and records rdtsc() - due in its latency_hist_t. Measuring from the
+    due time rather than the send time keeps the queueing delay that a
+    late reply causes (coordinated omission).
+*/
+static inline uint64_t
+workload_due(const workload_t *w, const workload_client_t *c, uint64_t start)
+{
+    return start + (uint64_t) (c->sent - 1) * w->interval;
+}
+
+#endif